@@ -0,0 +1,290 @@
+/*************************************************************************
+* Description:                                                           *
+* Hilbert filter kernels.  The folded difference x[n-k] - x[n-102+k]     *
+* needs 17 bits, so the vector kernels never form it in 16-bit lanes:    *
+* the x86 kernels interleave the mirrored samples and multiply them by   *
+* (h, -h) pairs with pmaddwd, and the NEON kernel widens the difference  *
+* to 32 bits before multiplying.                                         *
+*                                                                        *
+* A full-scale input can take the sum of all the taps past 32 bits,      *
+* where freq_shifter.vhd wraps.  Every kernel here instead sums          *
+* alternate taps into two accumulators, each of which always fits, and   *
+* halves their total exactly before saturating, so loud input clips      *
+* rather than flipping sign and the kernels still agree bit for bit.     *
+**************************************************************************/
+
+#include "hilbert.h"
+#include "vm_engine.h"
+#include "vm_sat.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define     HILBERT_HAVE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define     HILBERT_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+//each half of the taps times a 17-bit difference must fit in 32 bits
+#if !VM_SUM_FITS(VM_HILBERT_L1_EVEN, 17) || !VM_SUM_FITS(VM_HILBERT_L1_ODD, 17)
+#error "half of the Hilbert taps can overflow a 32-bit sum; split them further"
+#endif
+
+#define     FOLDED_TAP(x, k)    (vm_hilbert_coefs[k] * ((x)[-2*(k)] - (x)[-VM_HILBERT_ORDER + 2*(k)]))
+
+
+typedef struct
+{
+    void (*run)(const short* x, short* out, int n);
+    const char* name;
+} hilbert_kernel;
+
+// the kernel in use, chosen on first use unless set before; host tools filter from
+// several threads at once, so the pointer is only read and written atomically
+static const hilbert_kernel* current_kernel = 0;
+
+
+// handles whatever does not fill a whole vector
+static void hilbert_scalar(const short* x, short* out, int n)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++)
+    {
+        int even = 0;
+        int odd = 0;
+        for (k = 0; k + 1 < VM_HILBERT_TAPS; k += 2)
+        {
+            even += FOLDED_TAP(x + i, k);
+            odd += FOLDED_TAP(x + i, k + 1);
+        }
+        if (k < VM_HILBERT_TAPS)
+        {
+            even += FOLDED_TAP(x + i, k);
+        }
+        //(even + odd) >> 15
+        out[i] = vm_sat16(vm_half_sum(even, odd) >> 14);
+    }
+}
+
+
+#ifdef HILBERT_HAVE_X86
+
+// (h, -h) packed into one 32-bit lane for pmaddwd
+static int coef_pair(int k)
+{
+    unsigned int h = (unsigned short) vm_hilbert_coefs[k];
+    unsigned int neg = (unsigned short) -vm_hilbert_coefs[k];
+    return (int) (h | (neg << 16));
+}
+
+// adds tap k for outputs x[0..7] to the low and high halves' sums
+__attribute__((target("sse2")))
+static inline void tap_sse2(const short* x, int k, __m128i* lo, __m128i* hi)
+{
+    __m128i h = _mm_set1_epi32(coef_pair(k));
+    __m128i near = _mm_loadu_si128((const __m128i*) (x - 2*k));
+    __m128i far = _mm_loadu_si128((const __m128i*) (x - VM_HILBERT_ORDER + 2*k));
+    *lo = _mm_add_epi32(*lo, _mm_madd_epi16(_mm_unpacklo_epi16(near, far), h));
+    *hi = _mm_add_epi32(*hi, _mm_madd_epi16(_mm_unpackhi_epi16(near, far), h));
+}
+
+// (a + b) >> 15, as in hilbert_scalar
+__attribute__((target("sse2")))
+static inline __m128i combine_sse2(__m128i a, __m128i b)
+{
+    __m128i carry = _mm_and_si128(_mm_and_si128(a, b), _mm_set1_epi32(1));
+    __m128i half = _mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(a, 1), _mm_srai_epi32(b, 1)), carry);
+    return _mm_srai_epi32(half, 14);
+}
+
+__attribute__((target("sse2")))
+static void hilbert_sse2(const short* x, short* out, int n)
+{
+    int i, k;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i even_lo = _mm_setzero_si128();
+        __m128i even_hi = _mm_setzero_si128();
+        __m128i odd_lo = _mm_setzero_si128();
+        __m128i odd_hi = _mm_setzero_si128();
+        for (k = 0; k + 1 < VM_HILBERT_TAPS; k += 2)
+        {
+            tap_sse2(x + i, k, &even_lo, &even_hi);
+            tap_sse2(x + i, k + 1, &odd_lo, &odd_hi);
+        }
+        if (k < VM_HILBERT_TAPS)
+        {
+            tap_sse2(x + i, k, &even_lo, &even_hi);
+        }
+        _mm_storeu_si128((__m128i*) (out + i),
+                         _mm_packs_epi32(combine_sse2(even_lo, odd_lo), combine_sse2(even_hi, odd_hi)));
+    }
+    hilbert_scalar(x + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline void tap_avx2(const short* x, int k, __m256i* lo, __m256i* hi)
+{
+    __m256i h = _mm256_set1_epi32(coef_pair(k));
+    __m256i near = _mm256_loadu_si256((const __m256i*) (x - 2*k));
+    __m256i far = _mm256_loadu_si256((const __m256i*) (x - VM_HILBERT_ORDER + 2*k));
+    *lo = _mm256_add_epi32(*lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(near, far), h));
+    *hi = _mm256_add_epi32(*hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(near, far), h));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i combine_avx2(__m256i a, __m256i b)
+{
+    __m256i carry = _mm256_and_si256(_mm256_and_si256(a, b), _mm256_set1_epi32(1));
+    __m256i half = _mm256_add_epi32(_mm256_add_epi32(_mm256_srai_epi32(a, 1), _mm256_srai_epi32(b, 1)), carry);
+    return _mm256_srai_epi32(half, 14);
+}
+
+__attribute__((target("avx2")))
+static void hilbert_avx2(const short* x, short* out, int n)
+{
+    int i, k;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m256i even_lo = _mm256_setzero_si256();
+        __m256i even_hi = _mm256_setzero_si256();
+        __m256i odd_lo = _mm256_setzero_si256();
+        __m256i odd_hi = _mm256_setzero_si256();
+        for (k = 0; k + 1 < VM_HILBERT_TAPS; k += 2)
+        {
+            tap_avx2(x + i, k, &even_lo, &even_hi);
+            tap_avx2(x + i, k + 1, &odd_lo, &odd_hi);
+        }
+        if (k < VM_HILBERT_TAPS)
+        {
+            tap_avx2(x + i, k, &even_lo, &even_hi);
+        }
+        //unpack and pack both work within 128-bit lanes, so the outputs come back in order
+        _mm256_storeu_si256((__m256i*) (out + i),
+                            _mm256_packs_epi32(combine_avx2(even_lo, odd_lo), combine_avx2(even_hi, odd_hi)));
+    }
+    hilbert_sse2(x + i, out + i, n - i);
+}
+
+#endif /*HILBERT_HAVE_X86*/
+
+
+#ifdef HILBERT_HAVE_NEON
+
+static inline void tap_neon(const short* x, int k, int32x4_t* lo, int32x4_t* hi)
+{
+    int16x8_t near = vld1q_s16(x - 2*k);
+    int16x8_t far = vld1q_s16(x - VM_HILBERT_ORDER + 2*k);
+    *lo = vmlaq_n_s32(*lo, vsubl_s16(vget_low_s16(near), vget_low_s16(far)), vm_hilbert_coefs[k]);
+    *hi = vmlaq_n_s32(*hi, vsubl_s16(vget_high_s16(near), vget_high_s16(far)), vm_hilbert_coefs[k]);
+}
+
+static void hilbert_neon(const short* x, short* out, int n)
+{
+    int i, k;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        int32x4_t even_lo = vdupq_n_s32(0);
+        int32x4_t even_hi = vdupq_n_s32(0);
+        int32x4_t odd_lo = vdupq_n_s32(0);
+        int32x4_t odd_hi = vdupq_n_s32(0);
+        for (k = 0; k + 1 < VM_HILBERT_TAPS; k += 2)
+        {
+            tap_neon(x + i, k, &even_lo, &even_hi);
+            tap_neon(x + i, k + 1, &odd_lo, &odd_hi);
+        }
+        if (k < VM_HILBERT_TAPS)
+        {
+            tap_neon(x + i, k, &even_lo, &even_hi);
+        }
+        //the halving add is exact, then a saturating narrow by the remaining 14 bits
+        vst1q_s16(out + i, vcombine_s16(vqshrn_n_s32(vhaddq_s32(even_lo, odd_lo), 14),
+                                        vqshrn_n_s32(vhaddq_s32(even_hi, odd_hi), 14)));
+    }
+    hilbert_scalar(x + i, out + i, n - i);
+}
+
+#endif /*HILBERT_HAVE_NEON*/
+
+
+static int use_kernel(const hilbert_kernel* kernel)
+{
+    __atomic_store_n(&current_kernel, kernel, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int hilbert_set_kernel(int kernel)
+{
+    static const hilbert_kernel scalar = {hilbert_scalar, "scalar"};
+#ifdef HILBERT_HAVE_X86
+    static const hilbert_kernel sse2 = {hilbert_sse2, "sse2"};
+    static const hilbert_kernel avx2 = {hilbert_avx2, "avx2"};
+#endif
+#ifdef HILBERT_HAVE_NEON
+    static const hilbert_kernel neon = {hilbert_neon, "neon"};
+#endif
+
+    if (kernel == HILBERT_KERNEL_AUTO)
+    {
+#ifdef HILBERT_HAVE_X86
+        if (hilbert_set_kernel(HILBERT_KERNEL_AVX2) == 0)
+            return 0;
+        if (hilbert_set_kernel(HILBERT_KERNEL_SSE2) == 0)
+            return 0;
+#endif
+#ifdef HILBERT_HAVE_NEON
+        return hilbert_set_kernel(HILBERT_KERNEL_NEON);
+#endif
+        return hilbert_set_kernel(HILBERT_KERNEL_SCALAR);
+    }
+
+    switch (kernel)
+    {
+        case HILBERT_KERNEL_SCALAR:
+            return use_kernel(&scalar);
+#ifdef HILBERT_HAVE_X86
+        case HILBERT_KERNEL_SSE2:
+            if (!__builtin_cpu_supports("sse2"))
+                return -1;
+            return use_kernel(&sse2);
+        case HILBERT_KERNEL_AVX2:
+            if (!__builtin_cpu_supports("avx2"))
+                return -1;
+            return use_kernel(&avx2);
+#endif
+#ifdef HILBERT_HAVE_NEON
+        case HILBERT_KERNEL_NEON:
+            return use_kernel(&neon);
+#endif
+    }
+    return -1;
+}
+
+// threads that race to make the first choice all store the same kernel
+static const hilbert_kernel* selected_kernel(void)
+{
+    const hilbert_kernel* kernel = __atomic_load_n(&current_kernel, __ATOMIC_ACQUIRE);
+
+    if (kernel == 0)
+    {
+        hilbert_set_kernel(HILBERT_KERNEL_AUTO);
+        kernel = __atomic_load_n(&current_kernel, __ATOMIC_ACQUIRE);
+    }
+    return kernel;
+}
+
+const char* hilbert_kernel_name(void)
+{
+    return selected_kernel()->name;
+}
+
+void hilbert_block(const short* x, short* out, int n)
+{
+    selected_kernel()->run(x, out, n);
+}
@@ -0,0 +1,38 @@
+/*************************************************************************
+* Description:                                                           *
+* Block Hilbert filter kernels for the frequency shifter.  The filter    *
+* is the antisymmetric design of order VM_HILBERT_ORDER (vm_engine.h;    *
+* 102 by default, as in freq_shifter.vhd), so only its VM_HILBERT_TAPS   *
+* even taps are evaluated and each one is applied to the folded pair     *
+* x[n-k] - x[n-order+k].                                                 *
+*                                                                        *
+* A scalar kernel is always available; SSE2, AVX2 and NEON kernels are   *
+* compiled in on hosts that support them and picked at runtime.  All     *
+* kernels give identical results.  The choice is published atomically,   *
+* so any thread may filter, or make the first choice, at any time.       *
+**************************************************************************/
+
+#ifndef HILBERT_H_
+#define HILBERT_H_
+
+#define     HILBERT_KERNEL_AUTO     0
+#define     HILBERT_KERNEL_SCALAR   1
+#define     HILBERT_KERNEL_SSE2     2
+#define     HILBERT_KERNEL_AVX2     3
+#define     HILBERT_KERNEL_NEON     4
+
+
+// filters n samples: x points at the first new sample and must be preceded by
+// VM_HILBERT_ORDER samples of history; out[i] is the Q15 filter output for x[i],
+// saturated to 16 bits
+void hilbert_block(const short* x, short* out, int n);
+
+// selects a kernel; returns 0 on success, -1 if it is not available on this machine.
+// Blocks already running in other threads finish on the kernel they started with
+int hilbert_set_kernel(int kernel);
+
+// name of the kernel hilbert_block will use
+const char* hilbert_kernel_name(void);
+
+
+#endif /*HILBERT_H_*/
@@ -0,0 +1,367 @@
+/*************************************************************************
+* Description:                                                           *
+* Batch mode for archives of recorded calls: applies the board's shift,  *
+* echo and volume settings to every file given, far faster than real     *
+* time.  Files are spread over a work-stealing pool, one whole file per  *
+* task, so each worker streams one file at a time through its own        *
+* vm_engine.                                                             *
+*                                                                        *
+* Input is memory-mapped and consumed in large blocks.  Output is double *
+* buffered: while a file's writer thread writes one block the worker     *
+* processes the next into the other buffer, so the DSP never waits on   *
+* the disk unless the disk is the slower of the two.                     *
+*                                                                        *
+* Usage: batch [-s sin_step] [-c cos_step] [-d echo_delay]               *
+*              [-e echo_decay] [-v volume] [-w workers] [-r rate]        *
+*              -o out_dir in_file...                                     *
+* -v takes the params[1] volume setting (91 to 127, each step of 3 is    *
+*    3dB).  Here 109 is unity, so files keep their recorded level by     *
+*    default.  The board keeps the codec at MAX_VOLUME and applies the   *
+*    setting as a ramped digital gain, 3dB per step below 127, so on the *
+*    board the same default of 109 is 18dB down.                         *
+* -r reads and writes headerless 16-bit mono PCM at the given rate       *
+*    instead of WAV files                                                *
+* Outputs keep their input file names inside out_dir.                    *
+**************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "vm_pool.h"
+#include "wav.h"
+#include "../vm_engine.h"
+#include "../vm_sat.h"
+
+/* Frames per buffer; two of them per file being processed */
+#define     BATCH_BLOCK_FRAMES      65536
+#define     BATCH_UNITY_VOLUME      109
+
+
+// hands full buffers from a worker to the thread that writes them
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    wav_file* out;
+    short* buffers[2];
+    int lengths[2];
+    int full[2];
+    int finished;           // set by the worker once the last buffer is queued
+    int error;
+} batch_writer;
+
+typedef struct
+{
+    const char* in_path;
+    char* out_path;
+    int sample_rate;
+    long frames;
+    int failed;
+} batch_job;
+
+typedef struct
+{
+    batch_job* jobs;
+    const int* params;
+    int gain;               // Q15 volume, may exceed unity
+    int raw_rate;           // 0 for WAV files
+} batch_settings;
+
+typedef struct
+{
+    batch_settings* settings;
+    batch_job* job;
+} batch_task;
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void apply_gain(short* samples, int n, int gain)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        //the gain may exceed unity, so the product needs 64 bits before the shift
+        samples[i] = vm_sat16((int) (((long long) samples[i] * gain) >> 15));
+    }
+}
+
+// writes buffers in the order they were filled until the worker is finished
+static void* writer_thread(void* arg)
+{
+    batch_writer* w = (batch_writer*) arg;
+    int next = 0;
+
+    pthread_mutex_lock(&w->lock);
+    while (1)
+    {
+        while (!w->full[next] && !w->finished)
+        {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->full[next])
+        {
+            break;
+        }
+
+        //write without the lock so the worker can fill the other buffer meanwhile
+        pthread_mutex_unlock(&w->lock);
+        if (!w->error && wav_write_mono(w->out, w->buffers[next], w->lengths[next]) != 0)
+        {
+            w->error = 1;
+        }
+        pthread_mutex_lock(&w->lock);
+
+        w->full[next] = 0;
+        pthread_cond_signal(&w->cond);
+        next ^= 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// waits until buffer index is free for the worker to fill
+static short* writer_take(batch_writer* w, int index)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->full[index])
+    {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return w->buffers[index];
+}
+
+static void writer_queue(batch_writer* w, int index, int length)
+{
+    pthread_mutex_lock(&w->lock);
+    w->lengths[index] = length;
+    w->full[index] = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// streams one file through engine; returns 0 on success, -1 otherwise
+static int process_file(batch_settings* settings, batch_job* job, vm_engine* engine, short* buffers)
+{
+    batch_writer writer;
+    wav_file out;
+    wav_map in;
+    long position = 0;
+    int index = 0;
+
+    if ((settings->raw_rate ? wav_map_open_raw(&in, job->in_path, settings->raw_rate, 1)
+                            : wav_map_open(&in, job->in_path)) != 0)
+    {
+        fprintf(stderr, "Error: could not read %s\n", job->in_path);
+        return -1;
+    }
+    if ((settings->raw_rate ? wav_open_write_raw(&out, job->out_path, in.sample_rate)
+                            : wav_open_write(&out, job->out_path, in.sample_rate)) != 0)
+    {
+        fprintf(stderr, "Error: could not create %s\n", job->out_path);
+        wav_map_close(&in);
+        return -1;
+    }
+    job->sample_rate = in.sample_rate;
+
+    vm_engine_init(engine);
+    vm_engine_set_params(engine, settings->params);
+
+    memset(&writer, 0, sizeof(writer));
+    pthread_mutex_init(&writer.lock, NULL);
+    pthread_cond_init(&writer.cond, NULL);
+    writer.out = &out;
+    writer.buffers[0] = buffers;
+    writer.buffers[1] = buffers + BATCH_BLOCK_FRAMES;
+    pthread_create(&writer.thread, NULL, writer_thread, &writer);
+
+    while (position < in.frames)
+    {
+        short* block = writer_take(&writer, index);
+        int n = wav_map_read_mono(&in, position, block, BATCH_BLOCK_FRAMES);
+
+        vm_process_block(engine, block, block, n);
+        if (settings->gain != VM_DELAY_UNITY)
+        {
+            apply_gain(block, n, settings->gain);
+        }
+        writer_queue(&writer, index, n);
+        position += n;
+        index ^= 1;
+    }
+
+    pthread_mutex_lock(&writer.lock);
+    writer.finished = 1;
+    pthread_cond_signal(&writer.cond);
+    pthread_mutex_unlock(&writer.lock);
+    pthread_join(writer.thread, NULL);
+    pthread_cond_destroy(&writer.cond);
+    pthread_mutex_destroy(&writer.lock);
+
+    wav_close(&out);
+    wav_map_close(&in);
+    job->frames = position;
+    if (writer.error)
+    {
+        fprintf(stderr, "Error: could not write %s\n", job->out_path);
+        return -1;
+    }
+    return 0;
+}
+
+// processes one whole file; runs on a pool worker
+static void file_task(void* arg)
+{
+    batch_task* task = (batch_task*) arg;
+    vm_engine* engine = malloc(sizeof(vm_engine));
+    short* buffers = malloc(2 * BATCH_BLOCK_FRAMES * sizeof(short));
+
+    if (engine == NULL || buffers == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate buffers for %s\n", task->job->in_path);
+        task->job->failed = 1;
+    }
+    else
+    {
+        task->job->failed = (process_file(task->settings, task->job, engine, buffers) != 0);
+    }
+    free(buffers);
+    free(engine);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: batch [-s sin_step] [-c cos_step] [-d echo_delay] [-e echo_decay] [-v volume] [-w workers] [-r rate] -o out_dir in_file...\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    int params[10] = {1,109,4095,0,0,0};
+    int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    const char* out_dir = NULL;
+    batch_settings settings;
+    batch_task* tasks;
+    vm_pool pool;
+    int num_files;
+    long total_frames = 0;
+    double audio_seconds = 0.0;
+    double start, elapsed;
+    int failures = 0;
+    int i, f;
+
+    memset(&settings, 0, sizeof(settings));
+    for (i = 1; i < argc && argv[i][0] == '-'; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage();
+        if (strcmp(argv[i], "-s") == 0)
+            params[4] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            params[5] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            params[2] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-e") == 0)
+            params[3] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-v") == 0)
+            params[1] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-w") == 0)
+            workers = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            settings.raw_rate = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-o") == 0)
+            out_dir = argv[i+1];
+        else
+            usage();
+    }
+    num_files = argc - i;
+    if (out_dir == NULL || num_files <= 0 || workers <= 0 || settings.raw_rate < 0)
+        usage();
+
+    settings.params = params;
+    settings.gain = (int) lround(VM_DELAY_UNITY * pow(10.0, (params[1] - BATCH_UNITY_VOLUME) / 20.0));
+    settings.jobs = calloc(num_files, sizeof(batch_job));
+    tasks = calloc(num_files, sizeof(batch_task));
+    if (settings.jobs == NULL || tasks == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %d jobs\n", num_files);
+        return 1;
+    }
+    for (f = 0; f < num_files; f++)
+    {
+        const char* in_path = argv[i + f];
+        const char* name = strrchr(in_path, '/');
+        batch_job* job = &settings.jobs[f];
+
+        name = (name != NULL) ? name + 1 : in_path;
+        job->in_path = in_path;
+        job->out_path = malloc(strlen(out_dir) + strlen(name) + 2);
+        if (job->out_path == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate %d jobs\n", num_files);
+            return 1;
+        }
+        sprintf(job->out_path, "%s/%s", out_dir, name);
+        tasks[f].settings = &settings;
+        tasks[f].job = job;
+    }
+
+    if (vm_pool_init(&pool, workers) != 0)
+    {
+        fprintf(stderr, "Error: could not start %d workers\n", workers);
+        return 1;
+    }
+    start = now_seconds();
+    for (f = 0; f < num_files; f++)
+    {
+        vm_pool_submit(&pool, f, file_task, &tasks[f]);
+    }
+    vm_pool_wait(&pool);
+    elapsed = now_seconds() - start;
+
+    for (f = 0; f < num_files; f++)
+    {
+        batch_job* job = &settings.jobs[f];
+
+        if (job->failed)
+        {
+            failures++;
+            continue;
+        }
+        total_frames += job->frames;
+        audio_seconds += (double) job->frames / job->sample_rate;
+    }
+
+    printf("%d files, %d failed, %ld samples, %.1f s of audio in %.3f s (%.0fx real time)\n",
+           num_files, failures, total_frames, audio_seconds, elapsed,
+           (elapsed > 0.0) ? audio_seconds / elapsed : 0.0);
+    printf("%6s %10s %8s %12s\n", "worker", "files", "steals", "utilization");
+    for (i = 0; i < workers; i++)
+    {
+        vm_worker_stats stats;
+        double utilization = vm_pool_stats(&pool, i, &stats);
+        printf("%6d %10ld %8ld %11.1f%%\n", i, stats.executed, stats.steals, 100.0 * utilization);
+    }
+    vm_pool_destroy(&pool);
+
+    for (f = 0; f < num_files; f++)
+    {
+        free(settings.jobs[f].out_path);
+    }
+    free(settings.jobs);
+    free(tasks);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+/*************************************************************************
+* Description:                                                           *
+* Offline benchmark for every stage of the audio path: the frequency     *
+* shifter (Hilbert FIR and mixer), the echo, the phone path resampling   *
+* (codec rate down to the 8kHz PCM link and back) and the whole chain    *
+* as audio_data_task runs it.  Each stage is timed at every sample rate  *
+* and block size asked for and reported as ns per input sample, samples  *
+* per second on one core and last-level cache misses per 1000 samples.   *
+*                                                                        *
+* The input is fixed-seed noise, or a WAV file looped to length, so the  *
+* numbers only depend on the code and the machine.  Each measurement     *
+* is the fastest of several passes over the input with freshly           *
+* initialized state.  -j writes every measurement as JSON for tracking   *
+* regressions across commits.  The resample and chain stages go through  *
+* the 8kHz link, so rates that are not a multiple of it skip them with a *
+* note; shift and echo run at any rate.                                  *
+*                                                                        *
+* Usage: bench [-i in.wav] [-t seconds] [-n passes] [-r rate]...         *
+*              [-b block]... [-k stage]... [-l label] [-j out.json]      *
+* Defaults: synthetic input, 1 second, 3 passes, rates 8000 16000 32000  *
+* 48000, blocks 1 2 4 ... 1024, stages shift echo resample chain.        *
+* Cache misses read as unavailable where perf events are not permitted.  *
+**************************************************************************/
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "wav.h"
+#include "../hilbert.h"
+#include "../vm_engine.h"
+#include "../vm_resample.h"
+
+#define     BENCH_MAX_BLOCK     1024
+#define     BENCH_MAX_LIST      16
+#define     BENCH_LINK_RATE     8000    // rate of the Bluetooth PCM link
+#define     BENCH_SEED          1u
+
+#define     STAGE_SHIFT         0
+#define     STAGE_ECHO          1
+#define     STAGE_RESAMPLE      2
+#define     STAGE_CHAIN         3
+#define     NUM_STAGES          4
+
+
+typedef struct
+{
+    int stage;
+    int rate;
+    int block;
+    double ns_per_sample;
+    double misses_per_ksample;      // negative when the counter is unavailable
+} bench_result;
+
+// everything one measurement needs; large, so it is kept static
+typedef struct
+{
+    vm_engine engine;
+    vm_resampler down;
+    vm_resampler up;
+    short link[BENCH_MAX_BLOCK + VM_RESAMPLE_MAX_FACTOR];
+    short out[BENCH_MAX_BLOCK + VM_RESAMPLE_MAX_FACTOR];
+} bench_state;
+
+
+static const char* stage_names[NUM_STAGES] = {"shift", "echo", "resample", "chain"};
+
+// the board's echo and shift settings: 0.4 s delay, half decay, shift step 3
+static const int bench_params[10] = {1,109,895,16384,3,3};
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// opens a cache miss counter for this thread; returns -1 if perf events are not allowed
+static int open_miss_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// fixed-seed noise at half scale, so every run sees the same samples
+static void fill_synthetic(short* samples, long n)
+{
+    unsigned int seed = BENCH_SEED;
+    long i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        samples[i] = (short) (((int) (seed >> 16) - 32768) / 2);
+    }
+}
+
+// fills samples with the file, repeated as often as needed; returns 0 on success
+static int fill_from_wav(short* samples, long n, const char* path)
+{
+    wav_file wav;
+    long have = 0;
+    long length;
+
+    if (wav_open_read(&wav, path) != 0)
+    {
+        return -1;
+    }
+    while (have < n && wav.frames > 0)
+    {
+        int chunk = (n - have > 4096) ? 4096 : (int) (n - have);
+        have += wav_read_mono(&wav, samples + have, chunk);
+    }
+    wav_close(&wav);
+    if (have == 0)
+    {
+        return -1;
+    }
+    for (length = have; have < n; have++)
+    {
+        samples[have] = samples[have - length];
+    }
+    return 0;
+}
+
+static void reset_state(bench_state* s, int factor)
+{
+    vm_engine_init(&s->engine);
+    vm_engine_set_params(&s->engine, bench_params);
+    if (factor > 1)
+    {
+        vm_resampler_init(&s->down, factor);
+        vm_resampler_init(&s->up, factor);
+    }
+}
+
+// runs one pass of stage over n samples in blocks of block
+static void run_pass(bench_state* s, int stage, int factor, const short* in, long n, int block)
+{
+    long done;
+
+    for (done = 0; done + block <= n; done += block)
+    {
+        const short* x = in + done;
+        int frames;
+
+        switch (stage)
+        {
+            case STAGE_SHIFT:
+                vm_shift_block(&s->engine, x, s->out, block);
+                break;
+            case STAGE_ECHO:
+                vm_echo_block(&s->engine, x, s->out, block);
+                break;
+            case STAGE_RESAMPLE:
+                frames = vm_decimate(&s->down, x, s->link, block);
+                vm_interpolate(&s->up, s->link, s->out, frames);
+                break;
+            case STAGE_CHAIN:
+                if (factor > 1)
+                {
+                    frames = vm_decimate(&s->down, x, s->link, block);
+                    vm_process_block(&s->engine, s->link, s->link, frames);
+                    vm_interpolate(&s->up, s->link, s->out, frames);
+                }
+                else
+                {
+                    vm_process_block(&s->engine, x, s->out, block);
+                }
+                break;
+        }
+    }
+}
+
+// returns why stage cannot run at rate, or NULL if it can; only the stages
+// that pass through the PCM link need the rate to be a multiple of it
+static const char* stage_skip_reason(int stage, int rate)
+{
+    static vm_resampler probe;
+    int factor = rate / BENCH_LINK_RATE;
+
+    if (stage != STAGE_RESAMPLE && stage != STAGE_CHAIN)
+    {
+        return NULL;
+    }
+    if (rate % BENCH_LINK_RATE != 0)
+    {
+        return "rate is not a multiple of the 8kHz link";
+    }
+    if (stage == STAGE_RESAMPLE && factor == 1)
+    {
+        return "nothing to resample at the link rate";
+    }
+    if (factor > 1 && vm_resampler_init(&probe, factor) != 0)
+    {
+        return "no resampler for this rate";
+    }
+    return NULL;
+}
+
+// times the fastest of passes runs; the stage must apply at rate
+static void measure(bench_result* result, int stage, int rate, int block,
+                    const short* in, long n, int passes, int counter)
+{
+    static bench_state state;
+    int factor = (stage == STAGE_RESAMPLE || stage == STAGE_CHAIN) ? rate / BENCH_LINK_RATE : 1;
+    long samples = n / block * block;
+    double best = -1.0;
+    long long best_misses = -1;
+    int p;
+
+    for (p = 0; p < passes; p++)
+    {
+        long long misses = -1;
+        double start, elapsed;
+
+        reset_state(&state, factor);
+        if (counter >= 0)
+        {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        start = now_ns();
+        run_pass(&state, stage, factor, in, samples, block);
+        elapsed = now_ns() - start;
+        if (counter >= 0)
+        {
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+            {
+                misses = -1;
+            }
+        }
+        if (best < 0.0 || elapsed < best)
+        {
+            best = elapsed;
+            best_misses = misses;
+        }
+    }
+
+    result->stage = stage;
+    result->rate = rate;
+    result->block = block;
+    result->ns_per_sample = best / samples;
+    result->misses_per_ksample = (best_misses < 0) ? -1.0 : best_misses * 1000.0 / samples;
+}
+
+// writes s as a JSON string literal, escaping quotes, backslashes and control characters
+static void write_json_string(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void write_json(FILE* f, const char* label, const char* input, double seconds, int passes,
+                       const bench_result* results, int count)
+{
+    int i;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"label\": ");
+    write_json_string(f, label);
+    fprintf(f, ",\n  \"input\": ");
+    write_json_string(f, input);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"seconds\": %g,\n", seconds);
+    fprintf(f, "  \"passes\": %d,\n", passes);
+    fprintf(f, "  \"hilbert_order\": %d,\n", VM_HILBERT_ORDER);
+    fprintf(f, "  \"hilbert_kernel\": \"%s\",\n", hilbert_kernel_name());
+    fprintf(f, "  \"results\": [\n");
+    for (i = 0; i < count; i++)
+    {
+        const bench_result* r = &results[i];
+        fprintf(f, "    {\"stage\": \"%s\", \"rate\": %d, \"block\": %d, \"ns_per_sample\": %.3f, "
+                   "\"samples_per_second\": %.0f, \"cache_misses_per_ksample\": ",
+                stage_names[r->stage], r->rate, r->block, r->ns_per_sample, 1e9 / r->ns_per_sample);
+        if (r->misses_per_ksample < 0.0)
+            fprintf(f, "null}");
+        else
+            fprintf(f, "%.3f}", r->misses_per_ksample);
+        fprintf(f, "%s\n", (i + 1 < count) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: bench [-i in.wav] [-t seconds] [-n passes] [-r rate]... [-b block]... [-k stage]... [-l label] [-j out.json]\n");
+    exit(1);
+}
+
+static int stage_from_name(const char* name)
+{
+    int s;
+
+    for (s = 0; s < NUM_STAGES; s++)
+    {
+        if (strcmp(name, stage_names[s]) == 0)
+        {
+            return s;
+        }
+    }
+    usage();
+    return -1;
+}
+
+
+int main(int argc, char** argv)
+{
+    static const int default_rates[] = {8000, 16000, 32000, 48000};
+    int rates[BENCH_MAX_LIST], blocks[BENCH_MAX_LIST], stages[BENCH_MAX_LIST];
+    int num_rates = 0, num_blocks = 0, num_stages = 0;
+    const char* wav_path = NULL;
+    const char* json_path = NULL;
+    const char* label = "";
+    double seconds = 1.0;
+    int passes = 3;
+    bench_result* results;
+    int count = 0;
+    int max_rate = 0;
+    short* input;
+    long n;
+    long length;
+    int counter;
+    const char* skip;
+    int i, s, r, b;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || i + 1 >= argc)
+            usage();
+        else if (strcmp(argv[i], "-i") == 0)
+            wav_path = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0)
+            passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && num_rates < BENCH_MAX_LIST)
+            rates[num_rates++] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && num_blocks < BENCH_MAX_LIST)
+            blocks[num_blocks++] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && num_stages < BENCH_MAX_LIST)
+            stages[num_stages++] = stage_from_name(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0)
+            label = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0)
+            json_path = argv[++i];
+        else
+            usage();
+    }
+    if (num_rates == 0)
+    {
+        for (; num_rates < 4; num_rates++)
+            rates[num_rates] = default_rates[num_rates];
+    }
+    if (num_blocks == 0)
+    {
+        for (b = 1; b <= BENCH_MAX_BLOCK; b *= 2)
+            blocks[num_blocks++] = b;
+    }
+    if (num_stages == 0)
+    {
+        for (; num_stages < NUM_STAGES; num_stages++)
+            stages[num_stages] = num_stages;
+    }
+    for (i = 0; i < num_blocks; i++)
+    {
+        if (blocks[i] < 1 || blocks[i] > BENCH_MAX_BLOCK)
+            usage();
+    }
+    for (i = 0; i < num_rates; i++)
+    {
+        if (rates[i] <= 0)
+            usage();
+        if (rates[i] > max_rate)
+            max_rate = rates[i];
+    }
+    if (seconds <= 0.0 || passes < 1)
+        usage();
+
+    //one buffer long enough for the highest rate; lower rates use its start
+    n = (long) (seconds * max_rate);
+    if (n < BENCH_MAX_BLOCK)
+        n = BENCH_MAX_BLOCK;
+    input = malloc(n * sizeof(short));
+    results = malloc((size_t) num_stages * num_rates * num_blocks * sizeof(bench_result));
+    if (input == NULL || results == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %ld samples\n", n);
+        return 1;
+    }
+    if (wav_path == NULL)
+    {
+        fill_synthetic(input, n);
+    }
+    else if (fill_from_wav(input, n, wav_path) != 0)
+    {
+        fprintf(stderr, "Error: could not read %s as 16-bit PCM WAV\n", wav_path);
+        return 1;
+    }
+
+    counter = open_miss_counter();
+    printf("hilbert order %d, %s kernel, %s input, best of %d\n", VM_HILBERT_ORDER, hilbert_kernel_name(),
+           (wav_path != NULL) ? wav_path : "synthetic", passes);
+    printf("%-9s %6s %6s %12s %14s %16s\n", "stage", "rate", "block", "ns/sample", "samples/s", "misses/ksample");
+    for (s = 0; s < num_stages; s++)
+    {
+        for (r = 0; r < num_rates; r++)
+        {
+            length = (long) (seconds * rates[r]);
+            if (length < BENCH_MAX_BLOCK)
+                length = BENCH_MAX_BLOCK;
+            skip = stage_skip_reason(stages[s], rates[r]);
+            if (skip != NULL)
+            {
+                printf("%-9s %6d %6s skipped: %s\n", stage_names[stages[s]], rates[r], "-", skip);
+                continue;
+            }
+            for (b = 0; b < num_blocks; b++)
+            {
+                bench_result* res = &results[count];
+                measure(res, stages[s], rates[r], blocks[b], input, length, passes, counter);
+                count++;
+                printf("%-9s %6d %6d %12.2f %14.0f ", stage_names[res->stage], res->rate, res->block,
+                       res->ns_per_sample, 1e9 / res->ns_per_sample);
+                if (res->misses_per_ksample < 0.0)
+                    printf("%16s\n", "n/a");
+                else
+                    printf("%16.2f\n", res->misses_per_ksample);
+            }
+        }
+    }
+    if (counter >= 0)
+    {
+        close(counter);
+    }
+
+    if (json_path != NULL)
+    {
+        FILE* f = fopen(json_path, "w");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Error: could not create %s\n", json_path);
+            return 1;
+        }
+        write_json(f, label, (wav_path != NULL) ? wav_path : "synthetic", seconds, passes, results, count);
+        fclose(f);
+    }
+    free(results);
+    free(input);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*************************************************************************
+* Description:                                                           *
+* Channel-count benchmark for vm_channels.  Runs banks of increasing     *
+* size on one thread and reports how many real-time channels one core    *
+* sustains at 8kHz and 32kHz.                                            *
+*                                                                        *
+* Usage: chanbench [seconds_of_audio]                                    *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../vm_channels.h"
+
+#define     BENCH_BLOCK_SIZE    VM_BLOCK_SIZE
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// returns the processing time per channel-sample, in nanoseconds
+static double run_bank(int channels, long samples)
+{
+    vm_channel_bank bank;
+    short* buf;
+    double start, elapsed;
+    unsigned int seed = 1;
+    long done;
+    int i, c;
+
+    if (vm_channels_init(&bank, channels) != 0)
+    {
+        return -1.0;
+    }
+    buf = malloc((size_t) BENCH_BLOCK_SIZE * channels * sizeof(short));
+    if (buf == NULL)
+    {
+        vm_channels_free(&bank);
+        return -1.0;
+    }
+
+    //fixed-seed noise at half scale, and a spread of shift and echo settings
+    for (i = 0; i < BENCH_BLOCK_SIZE * channels; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        buf[i] = (short) ((int) (seed >> 16) - 32768) / 2;
+    }
+    for (c = 0; c < channels; c++)
+    {
+        int params[10] = {1,109,4095 - 800 * (c % 6),0,3,3};
+        vm_channels_set_params(&bank, c, params);
+    }
+
+    start = now_seconds();
+    for (done = 0; done < samples; done += BENCH_BLOCK_SIZE)
+    {
+        vm_channels_process(&bank, buf, buf, BENCH_BLOCK_SIZE);
+    }
+    elapsed = now_seconds() - start;
+
+    free(buf);
+    vm_channels_free(&bank);
+    return elapsed * 1e9 / ((double) done * channels);
+}
+
+
+int main(int argc, char** argv)
+{
+    static const int bank_sizes[] = {1, 16, 64, 256, 1024};
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    long samples = (long) (seconds * 8000);
+    unsigned int i;
+
+    printf("%8s %14s %16s %16s\n", "channels", "ns/ch-sample", "channels@8kHz", "channels@32kHz");
+    for (i = 0; i < sizeof(bank_sizes) / sizeof(bank_sizes[0]); i++)
+    {
+        double cost = run_bank(bank_sizes[i], samples);
+        if (cost < 0.0)
+        {
+            fprintf(stderr, "Error: could not allocate %d channels\n", bank_sizes[i]);
+            return 1;
+        }
+        printf("%8d %14.2f %16.0f %16.0f\n", bank_sizes[i], cost, 1e9 / (cost * 8000), 1e9 / (cost * 32000));
+    }
+    return 0;
+}
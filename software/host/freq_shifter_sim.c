@@ -0,0 +1,95 @@
+/*************************************************************************
+* Description:                                                           *
+* Clock-level model of freq_shifter.vhd.  All arithmetic is done on      *
+* 32-bit unsigned values so overflow wraps exactly as std_logic_vector   *
+* arithmetic does in the hardware.                                       *
+**************************************************************************/
+
+#include <string.h>
+#include "freq_shifter_sim.h"
+
+
+// resize_to_lsb_trunc(x, 16) followed by a signed interpretation
+static int32_t trunc16(uint32_t value)
+{
+    return (int16_t) (value & 0xffff);
+}
+
+// output stage of the shifter: bits 30..15 with bit 31 copied into the top half
+static uint32_t rescale(uint32_t value)
+{
+    uint32_t low = (value >> 15) & 0xffff;
+    return (value & 0x80000000u) ? (low | 0xffff0000u) : low;
+}
+
+
+int fsim_init(fsim_state* sim, const int16_t* coefs, int num_coefs)
+{
+    if (num_coefs < 2 || num_coefs > FSIM_MAX_COEFS)
+    {
+        return -1;
+    }
+    memset(sim, 0, sizeof(*sim));
+    sim->num_coefs = num_coefs;
+    memcpy(sim->coefs, coefs, num_coefs * sizeof(int16_t));
+    return 0;
+}
+
+uint32_t fsim_step(fsim_state* sim, uint32_t incoming, uint32_t sine, uint32_t cosine)
+{
+    int n = sim->num_coefs;
+    int chain = 2 * (n - 1);        // length of the t array
+    int delays = 2 * n - 1;         // delay1 .. delay51 for 26 coefficients
+    uint32_t xmh[FSIM_MAX_COEFS];
+    uint32_t t[2 * FSIM_MAX_COEFS];
+    uint32_t hilbert_output, m1, m2, z;
+    int i;
+
+    //combinational logic, evaluated on the register values before the clock edge
+    for (i = 0; i < n; i++)
+    {
+        xmh[i] = (uint32_t) (trunc16(incoming) * (int32_t) sim->coefs[i]);
+    }
+
+    t[0] = sim->xmhd0invdd - sim->xmhd[1];
+    for (i = 1; i < n - 1; i++)
+    {
+        t[i] = sim->tdd[i-1] - sim->xmhd[i+1];
+    }
+    for (i = n - 1; i < chain; i++)
+    {
+        t[i] = sim->tdd[i-1] + sim->xmhd[chain - i];
+    }
+
+    hilbert_output = sim->tdd[chain-1] + sim->xmhd[0];
+    m1 = (uint32_t) (trunc16(sim->hilbert_output_latched) * trunc16(sim->latched_sine));
+    m2 = (uint32_t) (trunc16(sim->delay[delays-1]) * trunc16(sim->latched_cosine));
+    z = sim->m1_latched + sim->m2_latched + 1073741823u;
+
+    //clock edge
+    sim->xmhd0invdd = sim->xmhd0invd;
+    sim->xmhd0invd = 0u - sim->xmhd[0];
+    memcpy(sim->xmhd, xmh, n * sizeof(uint32_t));
+    memcpy(sim->tdd, sim->td, chain * sizeof(uint32_t));
+    memcpy(sim->td, t, chain * sizeof(uint32_t));
+
+    memmove(sim->delay + 1, sim->delay, (delays - 1) * sizeof(uint32_t));
+    sim->delay[0] = incoming;
+
+    sim->hilbert_output_latched = rescale(hilbert_output);
+    sim->m1_latched = m1;
+    sim->m2_latched = m2;
+    sim->outgoing_data = rescale(z);
+
+    //sine and cosine streams are latched after the audio sample
+    sim->latched_sine = sine;
+    sim->latched_cosine = cosine;
+
+    return sim->outgoing_data;
+}
+
+int fsim_latency(const fsim_state* sim)
+{
+    // delay1 .. delayN, then m2_latched feeding aso_outgoing_data
+    return 2 * sim->num_coefs;
+}
@@ -0,0 +1,57 @@
+/*************************************************************************
+* Description:                                                           *
+* Bit-exact, clock-level model of the freq_shifter component.  Every     *
+* register of freq_shifter.vhd is mirrored, so outputs match the         *
+* hardware sample for sample, including the 16-bit truncation done by    *
+* resize_to_lsb_trunc and the DC offset added to z.                      *
+*                                                                        *
+* One call to fsim_step is one clock edge with asi_incoming_valid set.   *
+* Sine and cosine values are latched after that edge, matching the       *
+* order in which audio_data_task used to write the three FIFOs.          *
+*                                                                        *
+* Note that the hardware pairs the Hilbert output for input n with the   *
+* direct-path sample n + 2, i.e. the two mixer inputs are misaligned by  *
+* two samples; the model keeps this so outputs stay bit-exact.           *
+**************************************************************************/
+
+#ifndef FREQ_SHIFTER_SIM_H_
+#define FREQ_SHIFTER_SIM_H_
+
+#include <stdint.h>
+
+/* Largest number of non-zero taps per half; 26 in the shipped design */
+#define     FSIM_MAX_COEFS      128
+
+
+typedef struct
+{
+    int num_coefs;                          // no_of_coefficients
+    int16_t coefs[FSIM_MAX_COEFS];          // h0_int, h2_int, ...
+
+    uint32_t xmhd[FSIM_MAX_COEFS];
+    uint32_t td[2 * FSIM_MAX_COEFS];
+    uint32_t tdd[2 * FSIM_MAX_COEFS];
+    uint32_t xmhd0invd;
+    uint32_t xmhd0invdd;
+    uint32_t delay[2 * FSIM_MAX_COEFS];     // delay1 .. delayN
+    uint32_t latched_sine;
+    uint32_t latched_cosine;
+    uint32_t hilbert_output_latched;
+    uint32_t m1_latched;
+    uint32_t m2_latched;
+    uint32_t outgoing_data;
+} fsim_state;
+
+
+// resets the model; coefs holds num_coefs even taps, starting at h0
+// returns 0 on success, -1 if num_coefs is out of range
+int fsim_init(fsim_state* sim, const int16_t* coefs, int num_coefs);
+
+// clocks one input sample through the pipeline and returns aso_outgoing_data
+uint32_t fsim_step(fsim_state* sim, uint32_t incoming, uint32_t sine, uint32_t cosine);
+
+// number of input samples between an input and the output it first affects
+int fsim_latency(const fsim_state* sim);
+
+
+#endif /*FREQ_SHIFTER_SIM_H_*/
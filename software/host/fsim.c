@@ -0,0 +1,194 @@
+/*************************************************************************
+* Description:                                                           *
+* Golden-vector harness for the freq_shifter model.                      *
+*                                                                        *
+* Usage: fsim [-c coefs.txt] -g vectors.txt          print outputs       *
+*        fsim [-c coefs.txt] vectors.txt golden.txt  compare to golden   *
+*        fsim [-c coefs.txt] -b samples              measure throughput  *
+*        fsim [-c coefs.txt] -l                      measure latency     *
+*                                                                        *
+* A vector file holds one "incoming sine cosine" triple per line and a   *
+* golden file holds one aso_outgoing_data value per line, all as signed  *
+* decimal 32-bit values (the default radix of a ModelSim list dump).     *
+* A coefficient file holds h0, h2, ... one per line, scaled by 32768.    *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freq_shifter_sim.h"
+#include "../vm_tables.h"
+
+#define     MAX_REPORTED_MISMATCHES     10
+
+
+static int load_coefs(const char* path, int16_t* coefs)
+{
+    FILE* f = fopen(path, "r");
+    long value;
+    int n = 0;
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+    while (n < FSIM_MAX_COEFS && fscanf(f, "%ld", &value) == 1)
+    {
+        coefs[n++] = (int16_t) value;
+    }
+    fclose(f);
+    return n;
+}
+
+static int run_vectors(fsim_state* sim, const char* vector_path, const char* golden_path)
+{
+    FILE* vectors = fopen(vector_path, "r");
+    FILE* golden = NULL;
+    long incoming, sine, cosine, expected;
+    long count = 0, mismatches = 0;
+
+    if (vectors == NULL)
+    {
+        fprintf(stderr, "Error: could not open %s\n", vector_path);
+        return 1;
+    }
+    if (golden_path != NULL)
+    {
+        golden = fopen(golden_path, "r");
+        if (golden == NULL)
+        {
+            fprintf(stderr, "Error: could not open %s\n", golden_path);
+            fclose(vectors);
+            return 1;
+        }
+    }
+
+    while (fscanf(vectors, "%ld %ld %ld", &incoming, &sine, &cosine) == 3)
+    {
+        int32_t out = (int32_t) fsim_step(sim, (uint32_t) incoming, (uint32_t) sine, (uint32_t) cosine);
+
+        if (golden == NULL)
+        {
+            printf("%ld\n", (long) out);
+        }
+        else if (fscanf(golden, "%ld", &expected) != 1)
+        {
+            fprintf(stderr, "Error: golden file ends at sample %ld\n", count);
+            mismatches++;
+            break;
+        }
+        else if ((int32_t) expected != out)
+        {
+            if (mismatches < MAX_REPORTED_MISMATCHES)
+            {
+                printf("sample %ld: expected %ld, got %ld\n", count, expected, (long) out);
+            }
+            mismatches++;
+        }
+        count++;
+    }
+
+    fclose(vectors);
+    if (golden != NULL)
+    {
+        fclose(golden);
+        printf("%ld samples, %ld mismatches\n", count, mismatches);
+    }
+    return mismatches != 0;
+}
+
+// drives a unit impulse through the direct path and reports when it appears
+static int measure_latency(fsim_state* sim)
+{
+    int expected = fsim_latency(sim);
+    int32_t idle = 0;
+    int i;
+
+    for (i = 0; i < 4 * expected; i++)
+    {
+        int32_t out = (int32_t) fsim_step(sim, i == 0 ? 16384 : 0, 0, 32767);
+        if (i == 0)
+        {
+            idle = out;
+        }
+        else if (out != idle)
+        {
+            printf("latency %d samples (model reports %d)\n", i, expected);
+            return i != expected;
+        }
+    }
+    printf("impulse never reached the output\n");
+    return 1;
+}
+
+// clocks a swept sinusoid through the model, stepping the sine table as audio_data_task did
+static int measure_throughput(fsim_state* sim, long samples)
+{
+    struct timespec start, end;
+    int sin_index = 0, cos_index = VM_NUM_SINE_SAMPLES / 4;
+    uint32_t check = 0;
+    double seconds;
+    long i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < samples; i++)
+    {
+        check ^= fsim_step(sim, (uint32_t) sine_samples[(i * 7) % VM_NUM_SINE_SAMPLES] / 2,
+                           (uint32_t) sine_samples[sin_index], (uint32_t) sine_samples[cos_index]);
+        sin_index = (sin_index + 3) % VM_NUM_SINE_SAMPLES;
+        cos_index = (cos_index + 3) % VM_NUM_SINE_SAMPLES;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%d coefficients: %ld samples in %.3f s, %.1f ns/sample, %.2f Msamples/s (checksum %08x)\n",
+           sim->num_coefs, samples, seconds, seconds * 1e9 / samples, samples / seconds * 1e-6,
+           (unsigned int) check);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: fsim [-c coefs.txt] (-g vectors.txt | vectors.txt golden.txt | -b samples | -l)\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    static fsim_state sim;
+    int16_t coefs[FSIM_MAX_COEFS];
+    int num_coefs = sizeof(hilbert_coefs_102) / sizeof(hilbert_coefs_102[0]);
+    int arg = 1;
+
+    //freq_shifter.vhd is built with the order-102 design
+    memcpy(coefs, hilbert_coefs_102, sizeof(hilbert_coefs_102));
+    if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0)
+    {
+        num_coefs = load_coefs(argv[arg+1], coefs);
+        if (num_coefs < 0)
+        {
+            fprintf(stderr, "Error: could not open %s\n", argv[arg+1]);
+            return 1;
+        }
+        arg += 2;
+    }
+    if (fsim_init(&sim, coefs, num_coefs) != 0)
+    {
+        fprintf(stderr, "Error: need 2 to %d coefficients, got %d\n", FSIM_MAX_COEFS, num_coefs);
+        return 1;
+    }
+
+    if (arg + 2 == argc && strcmp(argv[arg], "-g") == 0)
+        return run_vectors(&sim, argv[arg+1], NULL);
+    if (arg + 2 == argc && strcmp(argv[arg], "-b") == 0)
+        return measure_throughput(&sim, atol(argv[arg+1]));
+    if (arg + 1 == argc && strcmp(argv[arg], "-l") == 0)
+        return measure_latency(&sim);
+    if (arg + 2 == argc && argv[arg][0] != '-')
+        return run_vectors(&sim, argv[arg], argv[arg+1]);
+
+    usage();
+    return 1;
+}
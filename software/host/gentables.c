@@ -0,0 +1,431 @@
+/*************************************************************************
+* Description:                                                           *
+* Generates vm_tables.c and vm_tables.h: the sine tables used by the     *
+* oscillators, the Hilbert filter taps for each supported order and the  *
+* anti-aliasing lowpass taps for each resampling factor.                 *
+* The tables are compiled into the engine, so nothing is computed at     *
+* run time on the board.  The header also carries each filter's sums of  *
+* tap magnitudes, which the kernels check their headroom against when    *
+* they are compiled.                                                     *
+*                                                                        *
+* The Hilbert taps are a least-squares fit over [band, 1-band] of the    *
+* normalized frequency range, the same design as MATLAB's               *
+* firls(order, [band 1-band], [1 1], 'Hilbert'); order 102 with band     *
+* 0.05 reproduces the coefficients in freq_shifter.vhd exactly.          *
+*                                                                        *
+* The resampling filters are Kaiser-windowed sincs with the cutoff at    *
+* the low rate's Nyquist frequency and taps_per_phase taps per           *
+* polyphase branch, scaled to unity gain at DC.                          *
+*                                                                        *
+* Usage: gentables [-n sine_size] [-a amplitude] [-q quarter_bits]       *
+*                  [-b band] [-o order]... [-p taps_per_phase]           *
+*                  [-r factor]... output_dir                             *
+* Defaults reproduce the shipped tables: -n 320 -a 32768 -q 8 -b 0.05    *
+* -o 30 -o 62 -o 102 -p 24 -r 2 -r 3 -r 4 -r 6.  Orders must be of the  *
+* form 4k+2.                                                             *
+**************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define     MAX_ORDERS      8
+#define     MAX_TAPS        128
+#define     MAX_FACTORS     8
+#define     MAX_LOWPASS     1024
+#define     KAISER_BETA     5.0
+
+
+typedef struct
+{
+    int sine_size;
+    double amplitude;
+    int quarter_bits;
+    double band;
+    int num_orders;
+    int orders[MAX_ORDERS];
+    int taps_per_phase;
+    int num_factors;
+    int factors[MAX_FACTORS];
+} table_config;
+
+
+static int to_q15(double value)
+{
+    long rounded = lround(value);
+
+    if (rounded > 32767)
+    {
+        return 32767;
+    }
+    if (rounded < -32768)
+    {
+        return -32768;
+    }
+    return (int) rounded;
+}
+
+// integral of sin(j w) sin(k w) over [w1, w2]
+static double sin_sin_integral(int j, int k, double w1, double w2)
+{
+    double upper = -sin((j + k) * w2) / (2.0 * (j + k));
+    double lower = -sin((j + k) * w1) / (2.0 * (j + k));
+
+    if (j == k)
+    {
+        upper += w2 / 2.0;
+        lower += w1 / 2.0;
+    }
+    else
+    {
+        upper += sin((j - k) * w2) / (2.0 * (j - k));
+        lower += sin((j - k) * w1) / (2.0 * (j - k));
+    }
+    return upper - lower;
+}
+
+// least-squares Hilbert design; taps[t] is the coefficient at offset 2t from
+// the start of the filter, i.e. h0, h2, ... in freq_shifter.vhd terms
+static int design_hilbert(int order, double band, int* taps)
+{
+    static double a[MAX_TAPS][MAX_TAPS + 1];
+    int num_taps = (order + 2) / 4;
+    int center = order / 2;
+    double w1 = band * M_PI;
+    double w2 = (1.0 - band) * M_PI;
+    int j, k, col, row;
+
+    if (order % 4 != 2 || num_taps > MAX_TAPS)
+    {
+        return -1;
+    }
+
+    //normal equations for H(w) = sum c_k sin(k w) ~ 1, odd k only
+    for (j = 0; j < num_taps; j++)
+    {
+        int kj = 2 * j + 1;
+        for (k = 0; k < num_taps; k++)
+        {
+            a[j][k] = sin_sin_integral(kj, 2 * k + 1, w1, w2);
+        }
+        a[j][num_taps] = (cos(kj * w1) - cos(kj * w2)) / kj;
+    }
+
+    //Gauss-Jordan elimination with partial pivoting
+    for (col = 0; col < num_taps; col++)
+    {
+        int pivot = col;
+        for (row = col + 1; row < num_taps; row++)
+        {
+            if (fabs(a[row][col]) > fabs(a[pivot][col]))
+            {
+                pivot = row;
+            }
+        }
+        for (k = 0; k <= num_taps; k++)
+        {
+            double tmp = a[col][k];
+            a[col][k] = a[pivot][k];
+            a[pivot][k] = tmp;
+        }
+        for (row = 0; row < num_taps; row++)
+        {
+            double factor;
+            if (row == col)
+            {
+                continue;
+            }
+            factor = a[row][col] / a[col][col];
+            for (k = col; k <= num_taps; k++)
+            {
+                a[row][k] -= factor * a[col][k];
+            }
+        }
+    }
+
+    //c_k is split over the taps at center - k and center + k; the shipped filter
+    //keeps the negative half first
+    for (j = 0; j < num_taps; j++)
+    {
+        int offset = center - 2 * j;
+        double c = a[(offset - 1) / 2][num_taps] / a[(offset - 1) / 2][(offset - 1) / 2];
+        taps[j] = to_q15(-c / 2.0 * 32768.0);
+    }
+    return num_taps;
+}
+
+// zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// lowpass for resampling by factor, cutoff at 1/(2 factor) of the high rate
+static int design_lowpass(int factor, int taps_per_phase, int* taps)
+{
+    double h[MAX_LOWPASS];
+    int length = factor * taps_per_phase;
+    double center = (length - 1) / 2.0;
+    double sum = 0.0;
+    int j;
+
+    if (length > MAX_LOWPASS)
+    {
+        return -1;
+    }
+    for (j = 0; j < length; j++)
+    {
+        double t = (j - center) / factor;
+        double r = (j - center) / center;
+        double sinc = (t == 0.0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+        h[j] = sinc * bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / bessel_i0(KAISER_BETA);
+        sum += h[j];
+    }
+    for (j = 0; j < length; j++)
+    {
+        taps[j] = to_q15(h[j] / sum * 32768.0);
+    }
+    return length;
+}
+
+// sum of the magnitudes of every stride-th tap from first
+static int l1_norm(const int* taps, int num_taps, int first, int stride)
+{
+    int sum = 0;
+    int j;
+
+    for (j = first; j < num_taps; j += stride)
+    {
+        sum += abs(taps[j]);
+    }
+    return sum;
+}
+
+static void print_command(FILE* f, const table_config* config)
+{
+    int i;
+
+    fprintf(f, "// generated by host/gentables.c -n %d -a %.0f -q %d -b %g",
+            config->sine_size, config->amplitude, config->quarter_bits, config->band);
+    for (i = 0; i < config->num_orders; i++)
+    {
+        fprintf(f, " -o %d", config->orders[i]);
+    }
+    fprintf(f, " -p %d", config->taps_per_phase);
+    for (i = 0; i < config->num_factors; i++)
+    {
+        fprintf(f, " -r %d", config->factors[i]);
+    }
+    fprintf(f, "\n// do not edit; rerun the generator instead\n");
+}
+
+static int write_header(const char* dir, const table_config* config)
+{
+    char path[1024];
+    char name[64];
+    int taps[MAX_LOWPASS];
+    FILE* f;
+    int i, num_taps;
+
+    snprintf(path, sizeof(path), "%s/vm_tables.h", dir);
+    f = fopen(path, "w");
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    print_command(f, config);
+    fprintf(f, "\n#ifndef VM_TABLES_H_\n#define VM_TABLES_H_\n\n");
+    fprintf(f, "#define     VM_NUM_SINE_SAMPLES     %d\n", config->sine_size);
+    fprintf(f, "#define     VM_QUARTER_SINE_BITS    %d\n", config->quarter_bits);
+    fprintf(f, "#define     VM_RESAMPLE_TAPS_PER_PHASE  %d\n\n", config->taps_per_phase);
+    fprintf(f, "// one period of a sine wave, peak amplitude %.0f, in %d intervals\n",
+            config->amplitude, config->sine_size);
+    fprintf(f, "extern const int sine_samples[VM_NUM_SINE_SAMPLES];\n\n");
+    fprintf(f, "// first quarter period of the same sine wave in 2^VM_QUARTER_SINE_BITS intervals;\n");
+    fprintf(f, "// the last entry is the peak, kept so that interpolation never needs to wrap\n");
+    fprintf(f, "extern const short quarter_sine_samples[(1 << VM_QUARTER_SINE_BITS) + 1];\n\n");
+    fprintf(f, "// even taps h0, h2, ... of the Hilbert filter of each order, in Q15\n");
+    for (i = 0; i < config->num_orders; i++)
+    {
+        fprintf(f, "extern const short hilbert_coefs_%d[%d];\n", config->orders[i], (config->orders[i] + 2) / 4);
+    }
+    fprintf(f, "\n// symmetric lowpass for resampling by each factor, in Q15, unity gain at DC\n");
+    for (i = 0; i < config->num_factors; i++)
+    {
+        fprintf(f, "extern const short resample_coefs_%d[%d];\n", config->factors[i], config->factors[i] * config->taps_per_phase);
+    }
+    fprintf(f, "\n// sums of the tap magnitudes, for the headroom checks of vm_sat.h: entries\n");
+    fprintf(f, "// 0, 2, ... and 1, 3, ... of each hilbert_coefs table, and each resampling lowpass\n");
+    for (i = 0; i < config->num_orders; i++)
+    {
+        num_taps = design_hilbert(config->orders[i], config->band, taps);
+        snprintf(name, sizeof(name), "VM_HILBERT_L1_%d_EVEN", config->orders[i]);
+        fprintf(f, "#define     %-27s %d\n", name, l1_norm(taps, num_taps, 0, 2));
+        snprintf(name, sizeof(name), "VM_HILBERT_L1_%d_ODD", config->orders[i]);
+        fprintf(f, "#define     %-27s %d\n", name, l1_norm(taps, num_taps, 1, 2));
+    }
+    for (i = 0; i < config->num_factors; i++)
+    {
+        num_taps = design_lowpass(config->factors[i], config->taps_per_phase, taps);
+        snprintf(name, sizeof(name), "VM_RESAMPLE_L1_%d", config->factors[i]);
+        fprintf(f, "#define     %-27s %d\n", name, l1_norm(taps, num_taps, 0, 1));
+    }
+    fprintf(f, "\n#endif /*VM_TABLES_H_*/\n");
+
+    fclose(f);
+    return 0;
+}
+
+static int write_source(const char* dir, const table_config* config)
+{
+    char path[1024];
+    int taps[MAX_LOWPASS];
+    int quarter_size = 1 << config->quarter_bits;
+    FILE* f;
+    int i, j, num_taps;
+
+    snprintf(path, sizeof(path), "%s/vm_tables.c", dir);
+    f = fopen(path, "w");
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    print_command(f, config);
+    fprintf(f, "\n#include \"vm_tables.h\"\n\n");
+
+    fprintf(f, "const int sine_samples[VM_NUM_SINE_SAMPLES] = {\n");
+    for (i = 0; i < config->sine_size; i++)
+    {
+        fprintf(f, "    %d%s\n", to_q15(config->amplitude * sin(2.0 * M_PI * i / config->sine_size)),
+                (i + 1 < config->sine_size) ? "," : "");
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const short quarter_sine_samples[(1 << VM_QUARTER_SINE_BITS) + 1] = {\n");
+    for (i = 0; i <= quarter_size; i++)
+    {
+        fprintf(f, "    %d%s\n", to_q15(config->amplitude * sin(M_PI / 2.0 * i / quarter_size)),
+                (i < quarter_size) ? "," : "");
+    }
+    fprintf(f, "};\n");
+
+    for (i = 0; i < config->num_orders; i++)
+    {
+        num_taps = design_hilbert(config->orders[i], config->band, taps);
+        fprintf(f, "\nconst short hilbert_coefs_%d[%d] = {\n   ", config->orders[i], num_taps);
+        for (j = 0; j < num_taps; j++)
+        {
+            fprintf(f, " %d%s", taps[j], (j + 1 < num_taps) ? "," : "");
+            if (j % 13 == 12 && j + 1 < num_taps)
+            {
+                fprintf(f, "\n   ");
+            }
+        }
+        fprintf(f, "\n};\n");
+    }
+
+    for (i = 0; i < config->num_factors; i++)
+    {
+        num_taps = design_lowpass(config->factors[i], config->taps_per_phase, taps);
+        fprintf(f, "\nconst short resample_coefs_%d[%d] = {\n   ", config->factors[i], num_taps);
+        for (j = 0; j < num_taps; j++)
+        {
+            fprintf(f, " %d%s", taps[j], (j + 1 < num_taps) ? "," : "");
+            if (j % 12 == 11 && j + 1 < num_taps)
+            {
+                fprintf(f, "\n   ");
+            }
+        }
+        fprintf(f, "\n};\n");
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: gentables [-n sine_size] [-a amplitude] [-q quarter_bits] [-b band] [-o order]... [-p taps_per_phase] [-r factor]... output_dir\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    table_config config = {320, 32768.0, 8, 0.05, 0, {0}, 24, 0, {0}};
+    int i;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            config.sine_size = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-a") == 0)
+            config.amplitude = atof(argv[i+1]);
+        else if (strcmp(argv[i], "-q") == 0)
+            config.quarter_bits = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-b") == 0)
+            config.band = atof(argv[i+1]);
+        else if (strcmp(argv[i], "-o") == 0 && config.num_orders < MAX_ORDERS)
+            config.orders[config.num_orders++] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-p") == 0)
+            config.taps_per_phase = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-r") == 0 && config.num_factors < MAX_FACTORS)
+            config.factors[config.num_factors++] = atoi(argv[i+1]);
+        else
+            usage();
+    }
+    if (i != argc - 1 || config.sine_size <= 0 || config.quarter_bits < 1 || config.quarter_bits > 14
+        || config.band <= 0.0 || config.band >= 0.5 || config.taps_per_phase < 2)
+        usage();
+
+    if (config.num_orders == 0)
+    {
+        config.orders[0] = 30;
+        config.orders[1] = 62;
+        config.orders[2] = 102;
+        config.num_orders = 3;
+    }
+    if (config.num_factors == 0)
+    {
+        config.factors[0] = 2;
+        config.factors[1] = 3;
+        config.factors[2] = 4;
+        config.factors[3] = 6;
+        config.num_factors = 4;
+    }
+    for (i = 0; i < config.num_factors; i++)
+    {
+        if (config.factors[i] < 2 || config.factors[i] * config.taps_per_phase > MAX_LOWPASS)
+        {
+            fprintf(stderr, "Error: factor %d needs 2 to %d taps in total\n", config.factors[i], MAX_LOWPASS);
+            return 1;
+        }
+    }
+    for (i = 0; i < config.num_orders; i++)
+    {
+        if (config.orders[i] % 4 != 2 || (config.orders[i] + 2) / 4 > MAX_TAPS)
+        {
+            fprintf(stderr, "Error: order %d is not of the form 4k+2 (at most %d)\n", config.orders[i], 4 * MAX_TAPS - 2);
+            return 1;
+        }
+    }
+
+    if (write_header(argv[argc-1], &config) != 0 || write_source(argv[argc-1], &config) != 0)
+    {
+        fprintf(stderr, "Error: could not write tables to %s\n", argv[argc-1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,470 @@
+/*************************************************************************
+* Description:                                                           *
+* Pipelined version of audio_data_task for Linux.  Capture, frequency    *
+* shift, echo and sink each run on their own thread and pass whole       *
+* blocks through SPSC rings instead of the per-sample FIFO round trips.  *
+*                                                                        *
+* Blocks come from a pool and are never copied: capture reads the file   *
+* straight into a block, the stages process it in place and pass the     *
+* pointer on, and the sink references the same block for both channels   *
+* of a stereo output before handing it back to the pool.                 *
+*                                                                        *
+* Capture drops a block and counts an overrun when no pooled block is    *
+* free in paced mode, as a real audio source cannot wait; every other    *
+* stage applies back-pressure by waiting.                                *
+*                                                                        *
+* Every thread keeps a vm_stats of its own: time per block in its stage, *
+* and for the sink the capture-to-sink latency of every block.  They are *
+* read through snapshots and merged for the report at exit.              *
+*                                                                        *
+* Usage: pipeline [-s sin_step] [-c cos_step] [-d echo_delay]            *
+*                 [-e echo_decay] [-m latency_ms | -m throughput]        *
+*                 [-b block_frames] [-q pool_blocks] [-w watermark]      *
+*                 [-p] [-2] in.wav [out.wav]                             *
+* -m picks the block size, watermark and pool for a latency budget in    *
+*    milliseconds or for throughput; -b, -q and -w then override it      *
+* -p paces capture at the file's sample rate instead of running flat out *
+* -w makes each stage sleep on an eventfd until watermark blocks are     *
+*    queued and then run the whole batch; without it stages spin         *
+* -2 writes the output as stereo, the same block on both channels        *
+**************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm_block.h"
+#include "vm_config.h"
+#include "wav.h"
+#include "../vm_engine.h"
+#include "../vm_stats.h"
+
+#define     NUM_RINGS       3
+#define     NUM_STAGES      4       // capture, shift, echo, sink; also the vm_stats stage index
+
+
+typedef struct
+{
+    wav_file in;
+    wav_file out;
+    int have_out;
+    int stereo;
+    int paced;
+    vm_stream_config config;
+    vm_engine shift_engine;
+    vm_engine echo_engine;
+    vm_block_pool pool;
+    vm_ring rings[NUM_RINGS];       // capture -> shift -> echo -> sink
+    vm_stats stats[NUM_STAGES];     // one per thread, so each has a single writer
+    long captured_blocks;
+    long sunk_blocks;
+    long lost_blocks;               // sequence gaps seen by the sink
+} pipeline_state;
+
+
+// monotonic time in nanoseconds; wraps every 4.3 s, which only differences survive
+static unsigned int now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned int) (t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+// hands a partial batch downstream when this stage is about to stall
+static void flush_batch(vm_ring* out)
+{
+    if (out != NULL && out->event_fd >= 0)
+    {
+        vm_ring_wake(out, 1);
+    }
+}
+
+// waits for a free block; used by every stage but paced capture
+static vm_block* wait_acquire(vm_block_cache* cache, vm_ring* out)
+{
+    vm_block* block;
+
+    while ((block = vm_block_acquire(cache)) == NULL)
+    {
+        flush_batch(out);
+        sched_yield();
+    }
+    return block;
+}
+
+// takes the next block, sleeping on the ring's event if it has one
+static vm_block* wait_pop(vm_ring* in, vm_ring* out)
+{
+    vm_block* block = vm_ring_pop(in);
+
+    if (block == NULL)
+    {
+        flush_batch(out);
+        block = vm_ring_pop_wait(in);
+    }
+    return block;
+}
+
+// every ring can hold the whole pool, so a push only waits if that changes
+static void wait_push(vm_ring* ring, vm_block* block)
+{
+    while (vm_ring_push(ring, block) != 0)
+    {
+        sched_yield();
+    }
+}
+
+static void* capture_stage(void* arg)
+{
+    pipeline_state* state = (pipeline_state*) arg;
+    vm_ring* out = &state->rings[0];
+    vm_stats* stats = &state->stats[0];
+    vm_block_cache cache;
+    int frames = state->config.block_frames;
+    long period_ns = (long) (1e9 * frames / state->in.sample_rate);
+    struct timespec next;
+    long sequence = 0;
+    unsigned int start;
+    vm_block* block;
+
+    vm_block_cache_init(&cache, &state->pool);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (state->in.frames > 0)
+    {
+        if (state->paced)
+        {
+            next.tv_nsec += period_ns;
+            while (next.tv_nsec >= 1000000000L)
+            {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+            block = vm_block_acquire(&cache);
+            if (block == NULL)
+            {
+                //the source moves on whether or not there is room for its samples
+                static short discard[VM_BLOCK_MAX_FRAMES];
+                wav_read_mono(&state->in, discard, frames);
+                out->overruns++;
+                vm_stats_write_begin(stats);
+                stats->counters.overruns++;
+                vm_stats_write_end(stats);
+                sequence++;
+                continue;
+            }
+        }
+        else
+        {
+            block = wait_acquire(&cache, out);
+        }
+
+        start = now_ns();
+        block->n = wav_read_mono(&state->in, block->samples, frames);
+        block->sequence = sequence++;
+        block->timestamp = start;
+        vm_stats_write_begin(stats);
+        vm_stats_stage(stats, 0, now_ns() - start);
+        vm_stats_write_end(stats);
+        wait_push(out, block);
+        state->captured_blocks++;
+    }
+
+    //an empty block marks the end of the stream
+    block = wait_acquire(&cache, out);
+    block->n = 0;
+    block->sequence = sequence;
+    wait_push(out, block);
+    flush_batch(out);
+    vm_block_cache_flush(&cache);
+    return NULL;
+}
+
+// runs one engine stage in place between two rings until the end marker passes through
+static void run_stage(vm_ring* in, vm_ring* out, vm_engine* engine, vm_stats* stats, int index,
+                      void (*stage)(vm_engine*, const short*, short*, int))
+{
+    while (1)
+    {
+        vm_block* block = wait_pop(in, out);
+        int n = block->n;
+        unsigned int start = now_ns();
+
+        stage(engine, block->samples, block->samples, n);
+        vm_stats_write_begin(stats);
+        vm_stats_stage(stats, index, now_ns() - start);
+        vm_stats_write_end(stats);
+        wait_push(out, block);
+        if (n == 0)
+        {
+            flush_batch(out);
+            break;
+        }
+    }
+}
+
+static void* shift_stage(void* arg)
+{
+    pipeline_state* state = (pipeline_state*) arg;
+    run_stage(&state->rings[0], &state->rings[1], &state->shift_engine, &state->stats[1], 1, vm_shift_block);
+    return NULL;
+}
+
+static void* echo_stage(void* arg)
+{
+    pipeline_state* state = (pipeline_state*) arg;
+    run_stage(&state->rings[1], &state->rings[2], &state->echo_engine, &state->stats[2], 2, vm_echo_block);
+    return NULL;
+}
+
+static void* sink_stage(void* arg)
+{
+    pipeline_state* state = (pipeline_state*) arg;
+    vm_ring* in = &state->rings[2];
+    vm_stats* stats = &state->stats[3];
+    vm_block_cache cache;
+    long expected = 0;
+
+    vm_block_cache_init(&cache, &state->pool);
+    while (1)
+    {
+        vm_block* block = wait_pop(in, NULL);
+        vm_block* left;
+        vm_block* right;
+        int n = block->n;
+        unsigned int start = now_ns();
+
+        vm_stats_write_begin(stats);
+        if (block->sequence != expected)
+        {
+            //every lost block is a gap in the output
+            state->lost_blocks += block->sequence - expected;
+            stats->counters.underruns += block->sequence - expected;
+        }
+        expected = block->sequence + 1;
+
+        //both channels take a reference to the one mono block
+        left = block;
+        right = block;
+        vm_block_retain(right);
+        if (state->have_out && n > 0)
+        {
+            if (state->stereo)
+            {
+                wav_write_stereo(&state->out, left->samples, right->samples, n);
+            }
+            else
+            {
+                wav_write_mono(&state->out, left->samples, n);
+            }
+        }
+        if (n > 0)
+        {
+            unsigned int end = now_ns();
+            vm_stats_stage(stats, 3, end - start);
+            vm_stats_latency(stats, end - block->timestamp);
+        }
+        vm_stats_write_end(stats);
+        vm_block_release(&cache, left);
+        vm_block_release(&cache, right);
+
+        if (n == 0)
+        {
+            break;
+        }
+        state->sunk_blocks++;
+    }
+    vm_block_cache_flush(&cache);
+    return NULL;
+}
+
+// merges the per-thread statistics and prints them in microseconds
+static void report_stats(pipeline_state* state)
+{
+    static const char* stage_names[NUM_STAGES] = {"capture", "shift", "echo", "sink"};
+    vm_stats_counters total, counters;
+    int i;
+
+    memset(&total, 0, sizeof(total));
+    total.min_latency = 0xffffffffu;
+    for (i = 0; i < NUM_STAGES; i++)
+    {
+        while (vm_stats_snapshot(&state->stats[i], &counters) != 0)
+        {
+            sched_yield();
+        }
+        vm_stats_merge(&total, &counters);
+    }
+
+    printf("%-16s %10s %10s\n", "stage", "avg us", "max us");
+    for (i = 0; i < NUM_STAGES; i++)
+    {
+        vm_stage_stats* s = &total.stages[i];
+        if (s->runs > 0)
+        {
+            printf("%-16s %10.1f %10.1f\n", stage_names[i], s->total_ticks / 1e3 / s->runs, s->max_ticks / 1e3);
+        }
+    }
+    if (total.blocks > 0)
+    {
+        printf("latency us: min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f, jitter %.1f\n",
+               total.min_latency / 1e3, total.total_latency / 1e3 / total.blocks,
+               vm_stats_percentile(&total, 0.5) / 1e3, vm_stats_percentile(&total, 0.99) / 1e3,
+               total.max_latency / 1e3, (total.max_latency - total.min_latency) / 1e3);
+    }
+    printf("overruns %lu, underruns %lu\n", total.overruns, total.underruns);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: pipeline [-s sin_step] [-c cos_step] [-d echo_delay] [-e echo_decay] [-m latency_ms | -m throughput] [-b block_frames] [-q pool_blocks] [-w watermark] [-p] [-2] in.wav [out.wav]\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    static const char* ring_names[NUM_RINGS] = {"capture->shift", "shift->echo", "echo->sink"};
+    static pipeline_state state;
+    int params[10] = {1,109,4095,0,0,0};
+    const char* mode = NULL;
+    int block_frames = 0;
+    int pool_blocks = -1;
+    int watermark = -1;
+    pthread_t threads[NUM_STAGES];
+    void* (*stages[NUM_STAGES])(void*) = {capture_stage, shift_stage, echo_stage, sink_stage};
+    struct timespec start, end;
+    vm_block_pool_stats pool_stats;
+    double seconds;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+            state.paced = 1;
+        else if (strcmp(argv[i], "-2") == 0)
+            state.stereo = 1;
+        else if (i + 1 >= argc)
+            usage();
+        else if (strcmp(argv[i], "-s") == 0)
+            params[4] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0)
+            params[5] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0)
+            params[2] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0)
+            params[3] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0)
+            mode = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0)
+            block_frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-q") == 0)
+            pool_blocks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0)
+            watermark = atoi(argv[++i]);
+        else
+            usage();
+    }
+    if (i >= argc || argc - i > 2 || pool_blocks == 0 || block_frames < 0
+        || block_frames > VM_BLOCK_MAX_FRAMES)
+        usage();
+
+    if (wav_open_read(&state.in, argv[i]) != 0)
+    {
+        fprintf(stderr, "Error: could not read %s as 16-bit PCM WAV\n", argv[i]);
+        return 1;
+    }
+    if (i + 1 < argc)
+    {
+        if ((state.stereo ? wav_open_write_stereo(&state.out, argv[i+1], state.in.sample_rate)
+                          : wav_open_write(&state.out, argv[i+1], state.in.sample_rate)) != 0)
+        {
+            fprintf(stderr, "Error: could not create %s\n", argv[i+1]);
+            return 1;
+        }
+        state.have_out = 1;
+    }
+
+    if (mode == NULL)
+    {
+        vm_config_default(&state.config, state.in.sample_rate);
+    }
+    else if (strcmp(mode, "throughput") == 0)
+    {
+        vm_config_for_throughput(&state.config, state.in.sample_rate);
+    }
+    else if (vm_config_for_latency(&state.config, state.in.sample_rate, atof(mode)) != 0)
+    {
+        fprintf(stderr, "Error: a %s ms budget is below the %.2f ms algorithmic latency; try a lower VM_HILBERT_ORDER\n",
+                mode, vm_config_algorithmic_ms(&state.config));
+        return 1;
+    }
+    if (block_frames > 0)
+        state.config.block_frames = block_frames;
+    if (pool_blocks > 0)
+        state.config.pool_blocks = (unsigned int) pool_blocks;
+    if (watermark >= 0)
+        state.config.watermark = (unsigned int) watermark;
+    vm_config_report(&state.config);
+
+    if (vm_block_pool_init(&state.pool, state.config.pool_blocks, state.config.block_frames) != 0)
+    {
+        fprintf(stderr, "Error: could not allocate blocks\n");
+        return 1;
+    }
+    for (i = 0; i < NUM_RINGS; i++)
+    {
+        if (vm_ring_init(&state.rings[i], state.config.pool_blocks) != 0
+            || (state.config.watermark > 0 && vm_ring_enable_events(&state.rings[i], state.config.watermark) != 0))
+        {
+            fprintf(stderr, "Error: could not allocate rings\n");
+            return 1;
+        }
+    }
+    for (i = 0; i < NUM_STAGES; i++)
+    {
+        vm_stats_init(&state.stats[i]);
+    }
+    vm_engine_init(&state.shift_engine);
+    vm_engine_set_params(&state.shift_engine, params);
+    vm_engine_init(&state.echo_engine);
+    vm_engine_set_params(&state.echo_engine, params);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NUM_STAGES; i++)
+    {
+        pthread_create(&threads[i], NULL, stages[i], &state);
+    }
+    for (i = 0; i < NUM_STAGES; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("%ld blocks captured, %ld blocks written, %ld lost, %.3f s\n",
+           state.captured_blocks, state.sunk_blocks, state.lost_blocks, seconds);
+    printf("%-16s %10s %10s %10s %10s\n", "ring", "full", "empty", "overruns", "wakeups");
+    for (i = 0; i < NUM_RINGS; i++)
+    {
+        printf("%-16s %10ld %10ld %10ld %10ld\n", ring_names[i], state.rings[i].full_events,
+               state.rings[i].empty_events, state.rings[i].overruns, state.rings[i].wakeups);
+        vm_ring_free(&state.rings[i]);
+    }
+    report_stats(&state);
+    vm_block_pool_stats_get(&state.pool, &pool_stats);
+    printf("%u blocks pooled, high water %u, %ld refills, %ld flushes\n",
+           pool_stats.count, pool_stats.high_water, pool_stats.refills, pool_stats.flushes);
+    vm_block_pool_free(&state.pool);
+
+    wav_close(&state.in);
+    if (state.have_out)
+    {
+        wav_close(&state.out);
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*************************************************************************
+* Description:                                                           *
+* Multi-stream runtime for Linux.  Each stream runs the shift and echo   *
+* chain of audio_data_task in its own vm_engine; streams are sharded     *
+* across a work-stealing pool.  Blocks arrive in real time, one per      *
+* stream per block period, and each task runs one block of one stream.   *
+* Reports how far the streams fell behind, per-worker utilization and    *
+* steal counts.                                                          *
+*                                                                        *
+* Usage: poolrun [-w workers] [-s streams] [-t seconds] [-r rate]        *
+*                [-burst blocks] [-R record_dir] [-L threshold]          *
+* -burst gives stream 0 that many extra blocks once, halfway through,    *
+* to show the other streams carrying on while it catches up.             *
+* -R records every stream's output into shared segments in record_dir,   *
+* one segment per second of audio.                                       *
+* -L gives each stream its own output gain, 0 to +12dB in 3dB steps,     *
+* and limits its peaks to threshold.                                     *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "vm_pool.h"
+#include "vm_record.h"
+#include "../vm_engine.h"
+
+
+typedef struct
+{
+    vm_engine engine;
+    vm_limiter limiter;
+    short in[VM_BLOCK_SIZE];
+    short out[VM_BLOCK_SIZE];
+    atomic_int pending_blocks;  // blocks arrived and not yet processed
+    long processed_blocks;
+    long catch_up_block;        // processed_blocks once a burst is worked off, -1 if none
+    double caught_up_at;        // when processed_blocks reached catch_up_block
+    vm_pool* pool;
+    vm_recorder* recorder;      // NULL unless recording
+    int id;
+    int rate;
+} stream_state;
+
+/* Recording segments; each holds one second of audio at most */
+#define     RECORD_SEGMENT_BYTES    (64 << 20)
+#define     RECORD_WINDOW_NS        1000000000ULL
+
+/* Per-stream output gains for -L, 0 to +12dB in 3dB steps, Q15 */
+static const int stream_gains[] = {32768, 46286, 65381, 92353, 130452};
+#define     NUM_STREAM_GAINS        (int) (sizeof(stream_gains) / sizeof(stream_gains[0]))
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// processes the stream's oldest pending block and requeues itself while
+// more are waiting, so at most one task per stream is ever in flight
+static void stream_task(void* arg)
+{
+    stream_state* stream = (stream_state*) arg;
+
+    vm_process_block(&stream->engine, stream->in, stream->out, VM_BLOCK_SIZE);
+    if (stream->recorder != NULL)
+    {
+        //timestamps count audio time from the start of the run
+        uint64_t timestamp = (uint64_t) stream->processed_blocks * VM_BLOCK_SIZE * 1000000000ULL / stream->rate;
+        vm_recorder_write(stream->recorder, (uint32_t) stream->id, timestamp, stream->rate,
+                          stream->out, VM_BLOCK_SIZE);
+    }
+    stream->processed_blocks++;
+    if (stream->processed_blocks == stream->catch_up_block)
+    {
+        stream->caught_up_at = now_seconds();
+    }
+    if (atomic_fetch_sub(&stream->pending_blocks, 1) > 1)
+    {
+        vm_pool_submit(stream->pool, stream->id, stream_task, stream);
+    }
+}
+
+// queues blocks for a stream, starting its task if it was idle
+static void add_blocks(stream_state* stream, int blocks)
+{
+    if (atomic_fetch_add(&stream->pending_blocks, blocks) == 0)
+    {
+        vm_pool_submit(stream->pool, stream->id, stream_task, stream);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: poolrun [-w workers] [-s streams] [-t seconds] [-r rate] [-burst blocks] [-R record_dir] [-L threshold]\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int num_streams = 256;
+    double seconds = 10.0;
+    int rate = 8000;
+    int burst = 0;
+    const char* record_dir = NULL;
+    int limit_threshold = 0;
+    vm_recorder recorder;
+    vm_pool pool;
+    stream_state* streams;
+    unsigned int seed = 1;
+    long rounds, round, total_blocks = 0;
+    long period_ns;
+    struct timespec deadline;
+    int max_lag = 0, max_other_lag = 0;
+    long burst_round;
+    double start, burst_start = 0.0, elapsed;
+    int i, s;
+
+    for (i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage();
+        if (strcmp(argv[i], "-w") == 0)
+            workers = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            num_streams = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            seconds = atof(argv[i+1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            rate = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-burst") == 0)
+            burst = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-R") == 0)
+            record_dir = argv[i+1];
+        else if (strcmp(argv[i], "-L") == 0)
+            limit_threshold = atoi(argv[i+1]);
+        else
+            usage();
+    }
+    if (workers <= 0 || num_streams <= 0 || rate <= 0 || seconds <= 0.0 || limit_threshold < 0)
+        usage();
+
+    streams = calloc(num_streams, sizeof(stream_state));
+    if (streams == NULL || vm_pool_init(&pool, workers) != 0)
+    {
+        fprintf(stderr, "Error: could not set up %d streams on %d workers\n", num_streams, workers);
+        return 1;
+    }
+
+    if (record_dir != NULL && vm_recorder_open(&recorder, record_dir, RECORD_SEGMENT_BYTES, RECORD_WINDOW_NS) != 0)
+    {
+        fprintf(stderr, "Error: could not record into %s\n", record_dir);
+        return 1;
+    }
+
+    //fixed-seed input so runs are comparable
+    for (s = 0; s < num_streams; s++)
+    {
+        int params[10] = {1,109,4095 - 800 * (s % 6),0,3,3};
+        vm_engine_init(&streams[s].engine);
+        vm_engine_set_params(&streams[s].engine, params);
+        if (limit_threshold > 0)
+        {
+            vm_limiter_init(&streams[s].limiter, limit_threshold, VM_LIMITER_RELEASE);
+            vm_limiter_set_gain(&streams[s].limiter, stream_gains[s % NUM_STREAM_GAINS]);
+            vm_engine_set_limiter(&streams[s].engine, &streams[s].limiter);
+        }
+        streams[s].catch_up_block = -1;
+        streams[s].pool = &pool;
+        streams[s].recorder = (record_dir != NULL) ? &recorder : NULL;
+        streams[s].id = s;
+        streams[s].rate = rate;
+        for (i = 0; i < VM_BLOCK_SIZE; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            streams[s].in[i] = (short) ((int) (seed >> 16) - 32768) / 2;
+        }
+    }
+
+    rounds = (long) (seconds * rate / VM_BLOCK_SIZE);
+    burst_round = rounds / 2;
+    streams[0].catch_up_block = (burst > 0) ? burst_round + 1 + burst : -1;
+    period_ns = (long) (VM_BLOCK_SIZE * 1000000000LL / rate);
+    vm_pool_reset_stats(&pool);
+    start = now_seconds();
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (round = 0; round < rounds; round++)
+    {
+        //backlog left over from earlier periods; a stream that keeps up has none
+        for (s = 0; s < num_streams; s++)
+        {
+            int lag = atomic_load(&streams[s].pending_blocks);
+            if (s == 0)
+                max_lag = (lag > max_lag) ? lag : max_lag;
+            else
+                max_other_lag = (lag > max_other_lag) ? lag : max_other_lag;
+        }
+        if (round == burst_round)
+        {
+            burst_start = now_seconds();
+        }
+
+        //one new block per stream per period; each stream is homed on one worker
+        for (s = 0; s < num_streams; s++)
+        {
+            add_blocks(&streams[s], (s == 0 && round == burst_round) ? 1 + burst : 1);
+        }
+
+        deadline.tv_nsec += period_ns;
+        while (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+    vm_pool_wait(&pool);
+    elapsed = now_seconds() - start;
+
+    for (s = 0; s < num_streams; s++)
+    {
+        total_blocks += streams[s].processed_blocks;
+    }
+    printf("%d streams at %d Hz on %d workers: %ld blocks in %.3f s for %.3f s of audio\n",
+           num_streams, rate, workers, total_blocks, elapsed, seconds);
+    printf("most blocks behind: stream 0 %d, other streams %d\n", max_lag, max_other_lag);
+    if (streams[0].catch_up_block >= 0)
+    {
+        printf("stream 0 worked off its %d block burst in %.1f ms, %.1f block periods\n", burst,
+               (streams[0].caught_up_at - burst_start) * 1e3,
+               (streams[0].caught_up_at - burst_start) * 1e9 / period_ns);
+    }
+    printf("%6s %10s %10s %10s %8s\n", "worker", "tasks", "steals", "attempts", "util");
+    for (i = 0; i < workers; i++)
+    {
+        vm_worker_stats stats;
+        double utilization = vm_pool_stats(&pool, i, &stats);
+        printf("%6d %10ld %10ld %10ld %7.1f%%\n", i, stats.executed, stats.steals,
+               stats.steal_attempts, utilization * 100.0);
+    }
+
+    vm_pool_destroy(&pool);
+    if (record_dir != NULL)
+    {
+        vm_recorder_close(&recorder);
+        printf("recorded %ld blocks, %.1f MB in %ld segments, %ld stalls waiting for a segment\n",
+               atomic_load(&recorder.blocks), atomic_load(&recorder.bytes) / 1e6,
+               atomic_load(&recorder.segments), atomic_load(&recorder.stalls));
+    }
+    free(streams);
+    return 0;
+}
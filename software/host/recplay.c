@@ -0,0 +1,141 @@
+/*************************************************************************
+* Description:                                                           *
+* Reads recordings made with vm_recorder.  With only a directory it      *
+* lists every stream with its block count and time span; with a stream   *
+* it seeks to a time and writes the following audio to a WAV file.      *
+*                                                                        *
+* Usage: recplay dir                                                     *
+*        recplay dir stream start_ns seconds out.wav                     *
+* start_ns is a recording timestamp, as printed by the listing.          *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm_record.h"
+#include "wav.h"
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: recplay dir [stream start_ns seconds out.wav]\n");
+    exit(1);
+}
+
+// prints one line per stream, visiting the streams in id order
+static void list_streams(const vm_record_reader* reader)
+{
+    uint64_t from = 0;
+
+    printf("%d segments\n", reader->num_segments);
+    printf("%8s %10s %12s %20s %20s\n", "stream", "blocks", "samples", "first_ns", "last_ns");
+    while (1)
+    {
+        uint64_t stream = UINT64_MAX;
+        vm_record_cursor cursor;
+        const vm_record_block* block;
+        long count = 0, samples = 0;
+        uint64_t first = 0, last = 0;
+        int s;
+        size_t i;
+
+        //lowest stream id from "from" on; each index is sorted by stream
+        for (s = 0; s < reader->num_segments; s++)
+        {
+            const vm_record_segment_view* view = &reader->segments[s];
+            for (i = 0; i < view->count && view->entries[i].stream < from; i++)
+                ;
+            if (i < view->count && view->entries[i].stream < stream)
+                stream = view->entries[i].stream;
+        }
+        if (stream == UINT64_MAX || vm_record_seek(reader, (uint32_t) stream, 0, &cursor) != 0)
+        {
+            break;
+        }
+        while ((block = vm_record_next(reader, &cursor)) != NULL)
+        {
+            if (count++ == 0)
+                first = block->timestamp;
+            last = block->timestamp;
+            samples += block->count;
+        }
+        printf("%8u %10ld %12ld %20llu %20llu\n", (unsigned int) stream, count, samples,
+               (unsigned long long) first, (unsigned long long) last);
+        from = stream + 1;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    vm_record_reader reader;
+    vm_record_cursor cursor;
+    const vm_record_block* block;
+    wav_file out;
+    uint32_t stream;
+    uint64_t start;
+    double seconds;
+    long wanted = 0, written = 0;
+    int opened = 0;
+
+    if (argc != 2 && argc != 6)
+        usage();
+    if (vm_record_reader_open(&reader, argv[1]) != 0)
+    {
+        fprintf(stderr, "Error: could not read recordings in %s\n", argv[1]);
+        return 1;
+    }
+    if (argc == 2)
+    {
+        list_streams(&reader);
+        vm_record_reader_close(&reader);
+        return 0;
+    }
+
+    stream = (uint32_t) strtoul(argv[2], NULL, 10);
+    start = strtoull(argv[3], NULL, 10);
+    seconds = atof(argv[4]);
+    if (vm_record_seek(&reader, stream, start, &cursor) != 0)
+    {
+        fprintf(stderr, "Error: stream %u has nothing recorded from %s ns on\n", stream, argv[3]);
+        return 1;
+    }
+
+    while ((block = vm_record_next(&reader, &cursor)) != NULL && (!opened || written < wanted))
+    {
+        const short* samples = vm_record_samples(block);
+        long skip = 0;
+        long n = block->count;
+
+        if (!opened)
+        {
+            if (wav_open_write(&out, argv[5], (int) block->sample_rate) != 0)
+            {
+                fprintf(stderr, "Error: could not create %s\n", argv[5]);
+                return 1;
+            }
+            opened = 1;
+            wanted = (long) (seconds * block->sample_rate);
+
+            //the first block may have started before the requested time
+            if (block->timestamp < start)
+            {
+                skip = (long) ((start - block->timestamp) * block->sample_rate / 1000000000ULL);
+            }
+        }
+        if (skip > n)
+            skip = n;
+        if (n - skip > wanted - written)
+            n = skip + wanted - written;
+        wav_write_mono(&out, samples + skip, (int) (n - skip));
+        written += n - skip;
+    }
+
+    if (opened)
+    {
+        wav_close(&out);
+    }
+    printf("%ld samples of stream %u written to %s\n", written, stream, argv[5]);
+    vm_record_reader_close(&reader);
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*************************************************************************
+* Description:                                                           *
+* Converts a WAV file between rates with the polyphase resampler and     *
+* reports its cost, e.g. 32kHz codec audio down to the 8kHz PCM link.    *
+*                                                                        *
+* Usage: resample (-d | -u) factor in.wav out.wav                        *
+* -d divides the sample rate by factor, -u multiplies it.  The factor    *
+* must be one with generated taps (2, 3, 4 or 6).                        *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wav.h"
+#include "../vm_resample.h"
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: resample (-d | -u) factor in.wav out.wav\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    static short in_buf[VM_BLOCK_SIZE * VM_RESAMPLE_MAX_FACTOR];
+    static short out_buf[VM_BLOCK_SIZE * VM_RESAMPLE_MAX_FACTOR];
+    static vm_resampler r;
+    wav_file in, out;
+    int down, factor, out_rate, n, produced;
+    long inputs = 0;
+    double elapsed = 0.0;
+
+    if (argc != 5 || (strcmp(argv[1], "-d") != 0 && strcmp(argv[1], "-u") != 0))
+        usage();
+    down = (strcmp(argv[1], "-d") == 0);
+    factor = atoi(argv[2]);
+    if (vm_resampler_init(&r, factor) != 0)
+    {
+        fprintf(stderr, "Error: no filter taps for factor %d\n", factor);
+        return 1;
+    }
+
+    if (wav_open_read(&in, argv[3]) != 0)
+    {
+        fprintf(stderr, "Error: could not read %s as 16-bit PCM WAV\n", argv[3]);
+        return 1;
+    }
+    out_rate = down ? in.sample_rate / factor : in.sample_rate * factor;
+    if (wav_open_write(&out, argv[4], out_rate) != 0)
+    {
+        fprintf(stderr, "Error: could not create %s\n", argv[4]);
+        wav_close(&in);
+        return 1;
+    }
+
+    //whole multiples of the factor keep the decimator's output count fixed per block
+    while ((n = wav_read_mono(&in, in_buf, down ? VM_BLOCK_SIZE * factor : VM_BLOCK_SIZE)) > 0)
+    {
+        double start = now_ns();
+        if (down)
+        {
+            produced = vm_decimate(&r, in_buf, out_buf, n);
+        }
+        else
+        {
+            vm_interpolate(&r, in_buf, out_buf, n);
+            produced = n * factor;
+        }
+        elapsed += now_ns() - start;
+        inputs += n;
+
+        if (wav_write_mono(&out, out_buf, produced) != 0)
+        {
+            fprintf(stderr, "Error: write to %s failed\n", argv[4]);
+            break;
+        }
+    }
+
+    wav_close(&in);
+    wav_close(&out);
+
+    if (inputs > 0)
+    {
+        //filtering at the high rate and then dropping or zero-stuffing would cost
+        //the full filter length per high-rate sample
+        int high_rate_samples = down ? 1 : factor;
+        int polyphase = down ? (r.length / 2 + factor - 1) / factor : VM_RESAMPLE_TAPS_PER_PHASE * factor;
+        printf("%ld samples at %d Hz to %d Hz, %.1f ns/input sample\n",
+               inputs, in.sample_rate, out_rate, elapsed / inputs);
+        printf("%d multiplies per input sample, against %d for filtering at the high rate\n",
+               polyphase, r.length * high_rate_samples);
+    }
+    return 0;
+}
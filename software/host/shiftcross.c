@@ -0,0 +1,243 @@
+/*************************************************************************
+* Description:                                                           *
+* Crossover benchmark for the frequency shifter's Hilbert filter: times  *
+* the time-domain FIR against the overlap-save FFT filter of the same    *
+* order, at every transform size from twice the order up, and reports    *
+* where the FFT starts to win.  The FIR is the folded scalar form of     *
+* hilbert_scalar with the order set at runtime, so any order can be      *
+* compared; the built-in order is also timed with the vector kernel the  *
+* engine uses.                                                           *
+*                                                                        *
+* Usage: shiftcross [-t seconds] [-n passes] [-b block] [-o order]...    *
+*                   [-m max_fft_size]                                    *
+* Defaults: 8kHz fixed-seed noise, 1 second but at least 16 transforms,  *
+* 3 passes, blocks of 128, orders 30 62 102 254 510 1022 2046 4094 and   *
+* transforms up to 16384.                                                *
+* Latency is the delay the FFT adds on top of the FIR's order / 2.       *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../hilbert.h"
+#include "../vm_engine.h"
+
+#define     CROSS_RATE          8000
+#define     CROSS_MAX_ORDERS    16
+#define     CROSS_MAX_BLOCK     8192
+#define     CROSS_SEED          1u
+#define     CROSS_MIN_FRAMES    16
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// fixed-seed noise at half scale, so every run sees the same samples
+static void fill_synthetic(short* samples, long n)
+{
+    unsigned int seed = CROSS_SEED;
+    long i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        samples[i] = (short) (((int) (seed >> 16) - 32768) / 2);
+    }
+}
+
+// even taps of an order-sized ideal Hilbert filter in Q15; only their count matters for timing
+static void make_taps(short* taps, int order)
+{
+    int k;
+
+    for (k = 0; k < (order + 2) / 4; k++)
+    {
+        taps[k] = (short) (-20861 / (order / 2 - 2 * k));
+    }
+}
+
+// hilbert_scalar with the order as a variable; x is preceded by order samples of history
+static void fir_block(const short* x, short* out, int n, const short* taps, int order)
+{
+    int num_taps = (order + 2) / 4;
+    int i, k;
+
+    for (i = 0; i < n; i++)
+    {
+        unsigned int acc = 0;
+        for (k = 0; k < num_taps; k++)
+        {
+            acc += (unsigned int) (taps[k] * (x[i - 2*k] - x[i - order + 2*k]));
+        }
+        out[i] = (short) (((int) acc) >> 15);
+    }
+}
+
+// ns per sample of the fastest pass; fft_size 0 times the runtime-order FIR,
+// -1 the built-in kernel at VM_HILBERT_ORDER
+static double measure(const short* in, long n, int block, int order, int fft_size, int passes)
+{
+    static short hilbert_out[CROSS_MAX_BLOCK];
+    static short delayed_out[CROSS_MAX_BLOCK];
+    short* taps = malloc(((order + 2) / 4) * sizeof(short));
+    void* storage = (fft_size > 0) ? malloc(VM_FFT_SHIFTER_STORAGE(fft_size)) : NULL;
+    vm_fft_shifter fft;
+    long samples = (n - order) / block * block;
+    double best = -1.0;
+    int p;
+
+    if (taps == NULL || (fft_size > 0 && storage == NULL))
+    {
+        fprintf(stderr, "Error: could not allocate order %d\n", order);
+        exit(1);
+    }
+    make_taps(taps, order);
+
+    for (p = 0; p < passes; p++)
+    {
+        double start, elapsed;
+        long done;
+
+        if (fft_size > 0)
+        {
+            vm_fft_shifter_init(&fft, storage, order, fft_size, NULL);
+        }
+        start = now_ns();
+        for (done = 0; done < samples; done += block)
+        {
+            //in holds order samples of history in front of the first block
+            const short* x = in + order + done;
+            if (fft_size > 0)
+                vm_fft_shifter_block(&fft, x, hilbert_out, delayed_out, block);
+            else if (fft_size < 0)
+                hilbert_block(x, hilbert_out, block);
+            else
+                fir_block(x, hilbert_out, block, taps, order);
+        }
+        elapsed = now_ns() - start;
+        if (best < 0.0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    free(storage);
+    free(taps);
+    return best / samples;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: shiftcross [-t seconds] [-n passes] [-b block] [-o order]... [-m max_fft_size]\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    static const int default_orders[] = {30, 62, 102, 254, 510, 1022, 2046, 4094};
+    int orders[CROSS_MAX_ORDERS];
+    int num_orders = 0;
+    double seconds = 1.0;
+    int passes = 3;
+    int block = VM_BLOCK_SIZE;
+    int max_size = VM_FFT_MAX_SIZE;
+    int crossover = 0;
+    short* in;
+    long n;
+    int i, o;
+
+    for (i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage();
+        if (strcmp(argv[i], "-t") == 0)
+            seconds = atof(argv[i+1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            passes = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-b") == 0)
+            block = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-o") == 0 && num_orders < CROSS_MAX_ORDERS)
+            orders[num_orders++] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-m") == 0)
+            max_size = atoi(argv[i+1]);
+        else
+            usage();
+    }
+    if (num_orders == 0)
+    {
+        num_orders = sizeof(default_orders) / sizeof(default_orders[0]);
+        memcpy(orders, default_orders, sizeof(default_orders));
+    }
+    if (seconds <= 0.0 || passes <= 0 || block <= 0 || block > CROSS_MAX_BLOCK)
+        usage();
+    for (o = 0; o < num_orders; o++)
+    {
+        if (orders[o] <= 0 || orders[o] % 4 != 2)
+        {
+            fprintf(stderr, "Error: order %d is not of the form 4k+2\n", orders[o]);
+            return 1;
+        }
+    }
+
+    //at least CROSS_MIN_FRAMES transforms of the largest size, so none is timed on a few
+    n = (long) (seconds * CROSS_RATE);
+    if (n < (long) CROSS_MIN_FRAMES * max_size)
+        n = (long) CROSS_MIN_FRAMES * max_size;
+    n += 2 * CROSS_MAX_BLOCK + VM_FFT_MAX_SIZE;
+    in = malloc(n * sizeof(short));
+    if (in == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %ld samples\n", n);
+        return 1;
+    }
+    fill_synthetic(in, n);
+
+    printf("blocks of %d, %s kernel at order %d: %.2f ns/sample\n", block, hilbert_kernel_name(),
+           VM_HILBERT_ORDER, measure(in, n, block, VM_HILBERT_ORDER, -1, passes));
+    printf("%6s %10s %8s %10s %8s %8s\n", "order", "fir_ns", "fft_size", "fft_ns", "latency", "speedup");
+    for (o = 0; o < num_orders; o++)
+    {
+        double fir = measure(in, n, block, orders[o], 0, passes);
+        double best = -1.0;
+        int best_size = 0;
+        int size;
+
+        for (size = 2; size <= max_size && size <= VM_FFT_MAX_SIZE; size <<= 1)
+        {
+            double fft;
+            //smaller transforms spend most of their work on history
+            if (size < 2 * orders[o])
+                continue;
+            fft = measure(in, n, block, orders[o], size, passes);
+            if (best < 0.0 || fft < best)
+            {
+                best = fft;
+                best_size = size;
+            }
+        }
+        if (best_size == 0)
+        {
+            printf("%6d %10.2f %8s %10s %8s %8s\n", orders[o], fir, "-", "-", "-", "-");
+            continue;
+        }
+        printf("%6d %10.2f %8d %10.2f %8d %7.2fx\n", orders[o], fir, best_size, best,
+               best_size - orders[o], fir / best);
+        if (best < fir && crossover == 0)
+        {
+            crossover = orders[o];
+        }
+    }
+
+    if (crossover > 0)
+        printf("the FFT filter wins from order %d on\n", crossover);
+    else
+        printf("the FIR wins at every order measured\n");
+    free(in);
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*************************************************************************
+* Description:                                                           *
+* Accuracy against throughput for the sample representations of          *
+* vm_stages.h.  The same chain - decimation from 32kHz to 8kHz, the      *
+* frequency shift (Hilbert filter, oscillator and mixer), the echo, an   *
+* output gain and interpolation back to 32kHz - runs in each             *
+* representation over the same input.                                    *
+* Every stage is timed separately, as ns per 8kHz output sample, and     *
+* after every stage the signal is compared with the f64 chain, giving    *
+* the signal to error ratio and the effective bits it amounts to.        *
+*                                                                        *
+* Usage: typebench [-t seconds] [-n passes] [-b block]                   *
+* Defaults: 1 second of fixed-seed noise at a quarter of full scale, so  *
+* the chain stays clear of saturation and the error is rounding alone;   *
+* 3 passes, blocks of 128.  The settings are the board's: shift step 3,  *
+* 0.4s echo at half decay, and the output 3dB down.                      *
+* Build with -O3 -march=native to see what vectorization does for each   *
+* representation.                                                        *
+**************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../vm_resample.h"
+#include "../vm_stages.h"
+
+#define     TYPE_FACTOR         4       // 32kHz codec to the 8kHz link
+#define     TYPE_LENGTH         (TYPE_FACTOR * VM_RESAMPLE_TAPS_PER_PHASE)
+#define     TYPE_HISTORY        VM_RESAMPLE_TAPS_PER_PHASE      // in front of the interpolator input
+#define     TYPE_RING_SIZE      4096
+#define     TYPE_MAX_BLOCK      1024
+#define     TYPE_SEED           1u
+
+#define     STAGE_DECIMATE      0
+#define     STAGE_SHIFT         1
+#define     STAGE_ECHO          2
+#define     STAGE_GAIN          3
+#define     STAGE_INTERPOLATE   4
+#define     NUM_STAGES          5
+
+/* Board settings: shift step 3, the 0.4s echo of delay setting 895 at half decay, -3dB out */
+#define     TYPE_SHIFT_STEP     3
+#define     TYPE_ECHO_DELAY     3200
+#define     TYPE_ECHO_DECAY     16384
+#define     TYPE_GAIN           23198
+
+
+static const char* stage_names[NUM_STAGES] = {"decimate", "shift", "echo", "gain", "interp"};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// fixed-seed noise at a quarter of full scale
+static void fill_synthetic(short* samples, long n)
+{
+    unsigned int seed = TYPE_SEED;
+    long i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        samples[i] = (short) (((int) (seed >> 16) - 32768) / 4);
+    }
+}
+
+static double best_of(double best, double elapsed)
+{
+    return (best < 0.0 || elapsed < best) ? elapsed : best;
+}
+
+
+// defines run_<name>, which runs the chain over n_in inputs in blocks of block
+// 8kHz samples, writes the signal after every stage to out[stage] and the fastest
+// pass's ns per 8kHz sample of every stage to ns. Each buffer keeps its
+// history in front of it, so the stages can run block by block over whole arrays
+#define DEFINE_RUNNER(name, sample, coef, gain_type)                                           \
+static int run_##name(const short* input, long n_in, int block, int passes,                    \
+                      double* out[NUM_STAGES], double* ns)                                     \
+{                                                                                              \
+    long n = n_in / TYPE_FACTOR / block * block;                                               \
+    sample* wide = calloc(TYPE_LENGTH + n * TYPE_FACTOR, sizeof(sample));                      \
+    sample* link = calloc(VM_HILBERT_ORDER + n, sizeof(sample));                               \
+    sample* shifted = calloc(n, sizeof(sample));                                               \
+    sample* echoed = calloc(n, sizeof(sample));                                                \
+    sample* level = calloc(TYPE_HISTORY + n, sizeof(sample));                                  \
+    sample* restored = calloc(n * TYPE_FACTOR, sizeof(sample));                                \
+    sample* ring = calloc(TYPE_RING_SIZE, sizeof(sample));                                     \
+    coef lowpass[TYPE_LENGTH];                                                                 \
+    coef hilbert_taps[VM_HILBERT_TAPS];                                                        \
+    coef feedback;                                                                             \
+    gain_type gain = vm_stage_gain_from_q15_##name(TYPE_GAIN);                                 \
+    short q15;                                                                                 \
+    sample hilbert_out[TYPE_MAX_BLOCK], sin_buf[TYPE_MAX_BLOCK], cos_buf[TYPE_MAX_BLOCK];      \
+    int delay = TYPE_ECHO_DELAY;                                                               \
+    double start;                                                                              \
+    long b;                                                                                    \
+    int p, s;                                                                                  \
+                                                                                               \
+    if (wide == NULL || link == NULL || shifted == NULL || echoed == NULL || level == NULL     \
+        || ring == NULL || restored == NULL)                                                   \
+    {                                                                                          \
+        return -1;                                                                             \
+    }                                                                                          \
+    vm_stage_coefs_##name(resample_coefs_4, lowpass, TYPE_LENGTH);                             \
+    vm_stage_coefs_##name(vm_hilbert_coefs, hilbert_taps, VM_HILBERT_TAPS);                    \
+    q15 = TYPE_ECHO_DECAY;                                                                     \
+    vm_stage_coefs_##name(&q15, &feedback, 1);                                                 \
+    vm_stage_from_q15_##name(input, wide + TYPE_LENGTH, (int) (n * TYPE_FACTOR));              \
+                                                                                               \
+    for (s = 0; s < NUM_STAGES; s++)                                                           \
+    {                                                                                          \
+        ns[s] = -1.0;                                                                          \
+    }                                                                                          \
+    for (p = 0; p < passes; p++)                                                               \
+    {                                                                                          \
+        unsigned int phase = 0;                                                                \
+        unsigned int write_index = 0;                                                          \
+                                                                                               \
+        start = now_ns();                                                                      \
+        for (b = 0; b < n; b += block)                                                         \
+            vm_stage_decimate_##name(wide + TYPE_LENGTH + b * TYPE_FACTOR,                     \
+                                     link + VM_HILBERT_ORDER + b, block * TYPE_FACTOR,         \
+                                     lowpass, TYPE_LENGTH, TYPE_FACTOR);                       \
+        ns[STAGE_DECIMATE] = best_of(ns[STAGE_DECIMATE], now_ns() - start);                    \
+                                                                                               \
+        start = now_ns();                                                                      \
+        for (b = 0; b < n; b += block)                                                         \
+        {                                                                                      \
+            const sample* x = link + VM_HILBERT_ORDER + b;                                     \
+            vm_stage_hilbert_##name(x, hilbert_out, block, hilbert_taps);                      \
+            vm_stage_osc_##name(&phase, TYPE_SHIFT_STEP * VM_NCO_LEGACY_STEP,                  \
+                                sin_buf, cos_buf, block);                                      \
+            vm_stage_mix_##name(hilbert_out, x - VM_HILBERT_DELAY, sin_buf, cos_buf,           \
+                                shifted + b, block);                                           \
+        }                                                                                      \
+        ns[STAGE_SHIFT] = best_of(ns[STAGE_SHIFT], now_ns() - start);                          \
+                                                                                               \
+        memset(ring, 0, TYPE_RING_SIZE * sizeof(sample));                                      \
+        start = now_ns();                                                                      \
+        for (b = 0; b < n; b += block)                                                         \
+            vm_stage_echo_##name(ring, TYPE_RING_SIZE, &write_index, delay, feedback,          \
+                                 shifted + b, echoed + b, block);                              \
+        ns[STAGE_ECHO] = best_of(ns[STAGE_ECHO], now_ns() - start);                            \
+                                                                                               \
+        start = now_ns();                                                                      \
+        for (b = 0; b < n; b += block)                                                         \
+            vm_stage_gain_##name(echoed + b, level + TYPE_HISTORY + b, block, gain);           \
+        ns[STAGE_GAIN] = best_of(ns[STAGE_GAIN], now_ns() - start);                            \
+                                                                                               \
+        start = now_ns();                                                                      \
+        for (b = 0; b < n; b += block)                                                         \
+            vm_stage_interpolate_##name(level + TYPE_HISTORY + b, restored + b * TYPE_FACTOR,  \
+                                        block, lowpass, TYPE_LENGTH, TYPE_FACTOR);             \
+        ns[STAGE_INTERPOLATE] = best_of(ns[STAGE_INTERPOLATE], now_ns() - start);              \
+    }                                                                                          \
+                                                                                               \
+    for (s = 0; s < NUM_STAGES; s++)                                                           \
+    {                                                                                          \
+        ns[s] /= n;                                                                            \
+    }                                                                                          \
+    vm_stage_to_double_##name(link + VM_HILBERT_ORDER, out[STAGE_DECIMATE], (int) n);          \
+    vm_stage_to_double_##name(shifted, out[STAGE_SHIFT], (int) n);                             \
+    vm_stage_to_double_##name(echoed, out[STAGE_ECHO], (int) n);                               \
+    vm_stage_to_double_##name(level + TYPE_HISTORY, out[STAGE_GAIN], (int) n);                 \
+    vm_stage_to_double_##name(restored, out[STAGE_INTERPOLATE], (int) (n * TYPE_FACTOR));      \
+    free(wide);                                                                                \
+    free(link);                                                                                \
+    free(shifted);                                                                             \
+    free(echoed);                                                                              \
+    free(level);                                                                               \
+    free(restored);                                                                            \
+    free(ring);                                                                                \
+    return 0;                                                                                  \
+}
+
+DEFINE_RUNNER(q15, short, short, int)
+DEFINE_RUNNER(q15r, short, short, int)
+DEFINE_RUNNER(q31, int, short, int)
+DEFINE_RUNNER(f32, float, float, float)
+DEFINE_RUNNER(f64, double, double, double)
+
+typedef int (*runner)(const short* input, long n_in, int block, int passes, double* out[NUM_STAGES], double* ns);
+
+static const struct
+{
+    const char* name;
+    runner run;
+} representations[] =
+{
+    {"q15", run_q15},
+    {"q15r", run_q15r},
+    {"q31", run_q31},
+    {"f32", run_f32},
+    {"f64", run_f64},
+};
+
+#define     NUM_REPRESENTATIONS     (int) (sizeof(representations) / sizeof(representations[0]))
+#define     REFERENCE               (NUM_REPRESENTATIONS - 1)
+
+
+// signal to error ratio of x against reference, in dB; infinite when they match
+static double snr_db(const double* x, const double* reference, long n)
+{
+    double signal = 0.0, error = 0.0;
+    long i;
+
+    for (i = 0; i < n; i++)
+    {
+        signal += reference[i] * reference[i];
+        error += (x[i] - reference[i]) * (x[i] - reference[i]);
+    }
+    return (error > 0.0) ? 10.0 * log10(signal / error) : INFINITY;
+}
+
+// samples a stage writes for n at 8kHz
+static long stage_length(int stage, long n)
+{
+    return (stage == STAGE_INTERPOLATE) ? n * TYPE_FACTOR : n;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: typebench [-t seconds] [-n passes] [-b block]\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    double seconds = 1.0;
+    int passes = 3;
+    int block = VM_BLOCK_SIZE;
+    double* out[NUM_REPRESENTATIONS][NUM_STAGES];
+    double ns[NUM_REPRESENTATIONS][NUM_STAGES];
+    short* input;
+    long n_in, n;
+    int i, r, s;
+
+    for (i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage();
+        if (strcmp(argv[i], "-t") == 0)
+            seconds = atof(argv[i+1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            passes = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-b") == 0)
+            block = atoi(argv[i+1]);
+        else
+            usage();
+    }
+    if (seconds <= 0.0 || passes <= 0 || block <= 0 || block > TYPE_MAX_BLOCK)
+        usage();
+
+    n_in = (long) (seconds * 8000 * TYPE_FACTOR);
+    n = n_in / TYPE_FACTOR / block * block;
+    if (n == 0)
+        usage();
+    input = malloc(n_in * sizeof(short));
+    for (r = 0; r < NUM_REPRESENTATIONS; r++)
+    {
+        for (s = 0; s < NUM_STAGES; s++)
+        {
+            out[r][s] = malloc(n * TYPE_FACTOR * sizeof(double));
+            if (out[r][s] == NULL)
+            {
+                fprintf(stderr, "Error: could not allocate %ld samples\n", n);
+                return 1;
+            }
+        }
+    }
+    if (input == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %ld samples\n", n_in);
+        return 1;
+    }
+    fill_synthetic(input, n_in);
+
+    for (r = 0; r < NUM_REPRESENTATIONS; r++)
+    {
+        if (representations[r].run(input, n_in, block, passes, out[r], ns[r]) != 0)
+        {
+            fprintf(stderr, "Error: could not allocate the %s chain\n", representations[r].name);
+            return 1;
+        }
+    }
+
+    printf("%ld samples at 8000 Hz in blocks of %d, ns per sample and dB of signal to error against f64\n",
+           n, block);
+    printf("%-6s", "");
+    for (s = 0; s < NUM_STAGES; s++)
+        printf(" %8s", stage_names[s]);
+    printf(" %8s  ", "total");
+    for (s = 0; s < NUM_STAGES; s++)
+        printf(" %8s", stage_names[s]);
+    printf(" %6s\n", "bits");
+    for (r = 0; r < NUM_REPRESENTATIONS; r++)
+    {
+        double total = 0.0;
+
+        printf("%-6s", representations[r].name);
+        for (s = 0; s < NUM_STAGES; s++)
+        {
+            printf(" %8.2f", ns[r][s]);
+            total += ns[r][s];
+        }
+        printf(" %8.2f  ", total);
+        for (s = 0; s < NUM_STAGES; s++)
+            printf(" %8.1f", snr_db(out[r][s], out[REFERENCE][s], stage_length(s, n)));
+        printf(" %6.1f\n", (snr_db(out[r][NUM_STAGES-1], out[REFERENCE][NUM_STAGES-1],
+                                   stage_length(NUM_STAGES-1, n)) - 1.76) / 6.02);
+    }
+
+    for (r = 0; r < NUM_REPRESENTATIONS; r++)
+    {
+        for (s = 0; s < NUM_STAGES; s++)
+            free(out[r][s]);
+    }
+    free(input);
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*************************************************************************
+* Description:                                                           *
+* Block pool with per-thread caches.                                     *
+**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "vm_block.h"
+
+
+int vm_block_pool_init(vm_block_pool* pool, unsigned int count, int block_frames)
+{
+    size_t stride = (sizeof(vm_block) + block_frames * sizeof(short) + VM_CACHE_LINE - 1)
+                  & ~(size_t) (VM_CACHE_LINE - 1);
+    unsigned int i;
+
+    memset(pool, 0, sizeof(*pool));
+    if (count == 0 || block_frames <= 0 || block_frames > VM_BLOCK_MAX_FRAMES)
+    {
+        return -1;
+    }
+    pool->blocks = aligned_alloc(VM_CACHE_LINE, count * stride);
+    pool->free_blocks = malloc(count * sizeof(vm_block*));
+    if (pool->blocks == NULL || pool->free_blocks == NULL)
+    {
+        free(pool->blocks);
+        free(pool->free_blocks);
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    atomic_init(&pool->in_use, 0);
+    atomic_init(&pool->high_water, 0);
+    pool->count = count;
+    pool->block_frames = block_frames;
+    pool->stride = stride;
+    pool->cache_limit = count / 4;
+    if (pool->cache_limit > VM_BLOCK_CACHE_SIZE)
+    {
+        pool->cache_limit = VM_BLOCK_CACHE_SIZE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        vm_block* block = (vm_block*) (pool->blocks + i * stride);
+        memset(block, 0, stride);
+        atomic_init(&block->refs, 0);
+        block->pool = pool;
+        pool->free_blocks[i] = block;
+    }
+    pool->free_count = count;
+    return 0;
+}
+
+void vm_block_pool_free(vm_block_pool* pool)
+{
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->blocks);
+    free(pool->free_blocks);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void vm_block_pool_stats_get(vm_block_pool* pool, vm_block_pool_stats* stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    stats->count = pool->count;
+    stats->refills = pool->refills;
+    stats->flushes = pool->flushes;
+    pthread_mutex_unlock(&pool->lock);
+    stats->in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+}
+
+void vm_block_cache_init(vm_block_cache* cache, vm_block_pool* pool)
+{
+    cache->pool = pool;
+    cache->count = 0;
+}
+
+// moves up to n blocks between the cache and the free stack; positive n refills
+static void transfer(vm_block_cache* cache, int n)
+{
+    vm_block_pool* pool = cache->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    if (n > 0)
+    {
+        if ((unsigned int) n > pool->free_count)
+        {
+            n = (int) pool->free_count;
+        }
+        pool->free_count -= n;
+        memcpy(cache->blocks + cache->count, pool->free_blocks + pool->free_count, n * sizeof(vm_block*));
+        cache->count += n;
+        if (n > 0)
+        {
+            pool->refills++;
+        }
+    }
+    else
+    {
+        n = -n;
+        cache->count -= n;
+        memcpy(pool->free_blocks + pool->free_count, cache->blocks + cache->count, n * sizeof(vm_block*));
+        pool->free_count += n;
+        pool->flushes++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void vm_block_cache_flush(vm_block_cache* cache)
+{
+    if (cache->count > 0)
+    {
+        transfer(cache, -(int) cache->count);
+    }
+}
+
+vm_block* vm_block_acquire(vm_block_cache* cache)
+{
+    vm_block_pool* pool = cache->pool;
+    unsigned int in_use, high;
+    vm_block* block;
+
+    if (cache->count == 0)
+    {
+        transfer(cache, (pool->cache_limit > 1) ? pool->cache_limit / 2 : 1);
+        if (cache->count == 0)
+        {
+            return NULL;
+        }
+    }
+    block = cache->blocks[--cache->count];
+    atomic_store_explicit(&block->refs, 1, memory_order_relaxed);
+
+    //raise the high-water mark if this acquire set a new one
+    in_use = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    high = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (in_use > high
+           && !atomic_compare_exchange_weak_explicit(&pool->high_water, &high, in_use,
+                                                     memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+    return block;
+}
+
+void vm_block_retain(vm_block* block)
+{
+    atomic_fetch_add_explicit(&block->refs, 1, memory_order_relaxed);
+}
+
+void vm_block_release(vm_block_cache* cache, vm_block* block)
+{
+    if (atomic_fetch_sub_explicit(&block->refs, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    atomic_fetch_sub_explicit(&block->pool->in_use, 1, memory_order_relaxed);
+    cache->blocks[cache->count++] = block;
+    if (cache->count > cache->pool->cache_limit)
+    {
+        transfer(cache, -(int) (cache->count - cache->pool->cache_limit / 2));
+    }
+}
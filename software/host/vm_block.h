@@ -0,0 +1,106 @@
+/*************************************************************************
+* Description:                                                           *
+* Reference-counted audio blocks and the pool they come from.  Capture   *
+* fills a block taken from the pool, every stage works on it in place,   *
+* and the sink may hold several references to it, e.g. one per output   *
+* channel when mono is played on both sides.  The last release returns  *
+* the block to the pool, so samples are written once and never copied.  *
+*                                                                        *
+* Every thread that acquires or releases blocks does so through its own  *
+* vm_block_cache, a private free list that needs no synchronization.     *
+* Only when a cache runs dry or overflows does it take the pool lock to  *
+* move half a cache of blocks to or from the shared free stack.  A cache *
+* holds at most a quarter of the pool, so blocks parked in one thread's  *
+* cache can never starve the others.  All blocks are allocated up front; *
+* nothing is allocated while running.                                    *
+**************************************************************************/
+
+#ifndef VM_BLOCK_H_
+#define VM_BLOCK_H_
+
+#include <pthread.h>
+#include "vm_ring.h"
+
+/* Most blocks a thread keeps for itself; refills and flushes move half a cache */
+#define     VM_BLOCK_CACHE_SIZE     32
+
+/* Largest block a pool can be set up with, in frames */
+#define     VM_BLOCK_MAX_FRAMES     8192
+
+
+typedef struct vm_block_pool vm_block_pool;
+
+struct vm_block
+{
+    int n;
+    long sequence;                  // block number assigned by the capture stage
+    unsigned int timestamp;         // when capture filled it, in wrapping nanoseconds
+    atomic_int refs;
+    vm_block_pool* pool;
+    _Alignas(VM_CACHE_LINE) short samples[];   // pool->block_frames of them
+};
+
+struct vm_block_pool
+{
+    unsigned char* blocks;
+    unsigned int count;
+    int block_frames;
+    size_t stride;                  // bytes from one block to the next, a whole number of cache lines
+    unsigned int cache_limit;       // blocks one cache may hold; 0 for pools too small to share
+
+    // shared free stack; only touched to refill or flush a cache
+    pthread_mutex_t lock;
+    vm_block** free_blocks;
+    unsigned int free_count;
+    long refills;
+    long flushes;
+
+    // blocks held by callers, i.e. neither in a cache nor on the free stack
+    atomic_uint in_use;
+    atomic_uint high_water;
+};
+
+// a thread's private free list; must only be used by the thread that owns it
+typedef struct
+{
+    vm_block_pool* pool;
+    unsigned int count;
+    vm_block* blocks[VM_BLOCK_CACHE_SIZE + 1];     // one over the limit until a flush
+} vm_block_cache;
+
+typedef struct
+{
+    unsigned int count;             // blocks in the pool
+    unsigned int in_use;            // blocks held by callers now
+    unsigned int high_water;        // most blocks ever held at once
+    long refills;                   // caches refilled from the free stack
+    long flushes;                   // caches that overflowed back onto it
+} vm_block_pool_stats;
+
+
+// allocates count cache-line aligned blocks of block_frames samples, all free;
+// returns 0 on success
+int vm_block_pool_init(vm_block_pool* pool, unsigned int count, int block_frames);
+
+// frees the blocks; every cache must have been flushed
+void vm_block_pool_free(vm_block_pool* pool);
+
+void vm_block_pool_stats_get(vm_block_pool* pool, vm_block_pool_stats* stats);
+
+// starts an empty cache for the calling thread
+void vm_block_cache_init(vm_block_cache* cache, vm_block_pool* pool);
+
+// returns every block in the cache to the pool, e.g. before the thread exits
+void vm_block_cache_flush(vm_block_cache* cache);
+
+// takes a free block holding one reference, or returns NULL if all are in use
+vm_block* vm_block_acquire(vm_block_cache* cache);
+
+// adds a reference for another owner of the same samples
+void vm_block_retain(vm_block* block);
+
+// drops a reference; the last one puts the block in the caller's cache
+void vm_block_release(vm_block_cache* cache, vm_block* block);
+
+
+#endif /*VM_BLOCK_H_*/
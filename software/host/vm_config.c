@@ -0,0 +1,73 @@
+/*************************************************************************
+* Description:                                                           *
+* Pipeline configuration and latency accounting.                         *
+**************************************************************************/
+
+#include <stdio.h>
+#include "vm_config.h"
+#include "vm_block.h"
+
+
+// blocks of buffering per block period; a spinning stage takes one block at a time
+static int buffered_blocks(const vm_stream_config* config)
+{
+    int watermark = (config->watermark > 0) ? (int) config->watermark : 1;
+    return watermark + 1;
+}
+
+void vm_config_default(vm_stream_config* config, int sample_rate)
+{
+    config->sample_rate = sample_rate;
+    config->block_frames = VM_BLOCK_SIZE;
+    config->watermark = 0;
+    config->pool_blocks = 16;
+}
+
+int vm_config_for_latency(vm_stream_config* config, int sample_rate, double budget_ms)
+{
+    int budget = (int) (budget_ms * sample_rate / 1000.0);
+
+    vm_config_default(config, sample_rate);
+    config->watermark = 1;
+    config->block_frames = (budget - VM_HILBERT_DELAY) / buffered_blocks(config);
+    if (config->block_frames > VM_BLOCK_MAX_FRAMES)
+    {
+        config->block_frames = VM_BLOCK_MAX_FRAMES;
+    }
+    if (config->block_frames < 1)
+    {
+        config->block_frames = 1;
+        return -1;
+    }
+    return 0;
+}
+
+void vm_config_for_throughput(vm_stream_config* config, int sample_rate)
+{
+    vm_config_default(config, sample_rate);
+    config->block_frames = VM_THROUGHPUT_BLOCK_FRAMES;
+    config->watermark = VM_THROUGHPUT_WATERMARK;
+    //enough for every ring to hold a full batch at once
+    config->pool_blocks = 4 * VM_THROUGHPUT_WATERMARK;
+}
+
+double vm_config_algorithmic_ms(const vm_stream_config* config)
+{
+    return 1000.0 * VM_HILBERT_DELAY / config->sample_rate;
+}
+
+double vm_config_buffering_ms(const vm_stream_config* config)
+{
+    return 1000.0 * buffered_blocks(config) * config->block_frames / config->sample_rate;
+}
+
+void vm_config_report(const vm_stream_config* config)
+{
+    double algorithmic = vm_config_algorithmic_ms(config);
+    double buffering = vm_config_buffering_ms(config);
+
+    printf("%d frames per block at %d Hz, watermark %u, %u pooled blocks\n",
+           config->block_frames, config->sample_rate, config->watermark, config->pool_blocks);
+    printf("latency %.2f ms: %.2f ms algorithmic + %.2f ms buffering\n",
+           algorithmic + buffering, algorithmic, buffering);
+}
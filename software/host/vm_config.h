@@ -0,0 +1,49 @@
+/*************************************************************************
+* Description:                                                           *
+* Block size, watermark and pool size of a host pipeline, and the        *
+* latency they add up to.  A latency budget picks the largest block     *
+* that still fits; throughput mode picks large blocks and batches.       *
+*                                                                        *
+* Latency is counted from a sample entering capture to it leaving the    *
+* sink:                                                                  *
+*   algorithmic - the Hilbert filter delays the direct path by           *
+*                 VM_HILBERT_DELAY samples so the two line up            *
+*   buffering   - capture fills a whole block before passing it on, the  *
+*                 first stage waits for watermark blocks, and the sink   *
+*                 plays a block out over one block period                *
+**************************************************************************/
+
+#ifndef VM_CONFIG_H_
+#define VM_CONFIG_H_
+
+#define     VM_THROUGHPUT_BLOCK_FRAMES  4096
+#define     VM_THROUGHPUT_WATERMARK     4
+
+
+typedef struct
+{
+    int sample_rate;
+    int block_frames;
+    unsigned int watermark;         // blocks queued before a sleeping stage wakes; 0 spins
+    unsigned int pool_blocks;
+} vm_stream_config;
+
+
+// defaults: VM_BLOCK_SIZE frames, spinning stages, 16 pooled blocks
+void vm_config_default(vm_stream_config* config, int sample_rate);
+
+// largest block that keeps the total latency within budget_ms, with a
+// watermark of one; returns 0 on success, -1 if even one-frame blocks miss it
+int vm_config_for_latency(vm_stream_config* config, int sample_rate, double budget_ms);
+
+// large blocks handed on in batches, for offline or many-stream use
+void vm_config_for_throughput(vm_stream_config* config, int sample_rate);
+
+double vm_config_algorithmic_ms(const vm_stream_config* config);
+double vm_config_buffering_ms(const vm_stream_config* config);
+
+// prints the settings and the latency they give
+void vm_config_report(const vm_stream_config* config);
+
+
+#endif /*VM_CONFIG_H_*/
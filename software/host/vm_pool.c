@@ -0,0 +1,262 @@
+/*************************************************************************
+* Description:                                                           *
+* Work-stealing thread pool.  Each queue is a ring guarded by its own    *
+* mutex; the owner and thieves only contend when they touch the same     *
+* queue, which is rare while every worker has its own streams.           *
+**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm_pool.h"
+
+#define     QUEUE_MASK      (VM_POOL_QUEUE_SIZE - 1)
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int push_task(vm_worker_queue* queue, vm_task_fn fn, void* arg)
+{
+    int pushed = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail - queue->head < VM_POOL_QUEUE_SIZE)
+    {
+        queue->tasks[queue->tail & QUEUE_MASK].fn = fn;
+        queue->tasks[queue->tail & QUEUE_MASK].arg = arg;
+        queue->tail++;
+        pushed = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return pushed;
+}
+
+// the owner takes the newest task, which is most likely still in cache
+static int pop_task(vm_worker_queue* queue, vm_task* task)
+{
+    int popped = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail != queue->head)
+    {
+        queue->tail--;
+        *task = queue->tasks[queue->tail & QUEUE_MASK];
+        popped = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return popped;
+}
+
+// thieves take the oldest task, which its owner would reach last
+static int steal_task(vm_worker_queue* queue, vm_task* task)
+{
+    int stolen = 0;
+
+    if (pthread_mutex_trylock(&queue->lock) != 0)
+    {
+        return 0;
+    }
+    if (queue->tail != queue->head)
+    {
+        *task = queue->tasks[queue->head & QUEUE_MASK];
+        queue->head++;
+        stolen = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return stolen;
+}
+
+static int find_task(vm_pool* pool, vm_worker_queue* own, vm_task* task)
+{
+    int i;
+
+    if (pop_task(own, task))
+    {
+        return 1;
+    }
+    for (i = 1; i < pool->num_workers; i++)
+    {
+        vm_worker_queue* victim = &pool->queues[(own->index + i) % pool->num_workers];
+
+        own->stats.steal_attempts++;
+        if (steal_task(victim, task))
+        {
+            own->stats.steals++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void finish_task(vm_pool* pool)
+{
+    if (atomic_fetch_sub(&pool->outstanding, 1) == 1)
+    {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_broadcast(&pool->done_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+static void* worker_main(void* arg)
+{
+    vm_worker_queue* own = (vm_worker_queue*) arg;
+    vm_pool* pool = own->pool;
+    vm_task task;
+
+    while (1)
+    {
+        if (find_task(pool, own, &task))
+        {
+            double start = now_ns();
+
+            atomic_fetch_sub(&pool->queued, 1);
+            task.fn(task.arg);
+            own->stats.busy_ns += now_ns() - start;
+            own->stats.executed++;
+            finish_task(pool);
+            continue;
+        }
+
+        //nothing to run anywhere: sleep until something is submitted
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->shutdown)
+        {
+            pthread_cond_wait(&pool->work_cond, &pool->idle_lock);
+        }
+        if (pool->shutdown && atomic_load(&pool->queued) == 0)
+        {
+            pthread_mutex_unlock(&pool->idle_lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return NULL;
+}
+
+
+// stops and joins the first started workers and frees the pool
+static void stop_workers(vm_pool* pool, int started)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (i = 0; i < pool->num_workers; i++)
+    {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool->queues);
+    memset(pool, 0, sizeof(*pool));
+}
+
+
+int vm_pool_init(vm_pool* pool, int num_workers)
+{
+    int i;
+
+    memset(pool, 0, sizeof(*pool));
+    if (num_workers <= 0)
+    {
+        return -1;
+    }
+    pool->threads = calloc(num_workers, sizeof(pthread_t));
+    pool->queues = calloc(num_workers, sizeof(vm_worker_queue));
+    if (pool->threads == NULL || pool->queues == NULL)
+    {
+        free(pool->threads);
+        free(pool->queues);
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->outstanding, 0);
+    pool->started_ns = now_ns();
+
+    for (i = 0; i < num_workers; i++)
+    {
+        pool->queues[i].pool = pool;
+        pool->queues[i].index = i;
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+    //the workers read num_workers as soon as they start, so it is set first
+    pool->num_workers = num_workers;
+    for (i = 0; i < num_workers; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->queues[i]) != 0)
+        {
+            stop_workers(pool, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void vm_pool_submit(vm_pool* pool, int worker, vm_task_fn fn, void* arg)
+{
+    atomic_fetch_add(&pool->outstanding, 1);
+    if (!push_task(&pool->queues[worker % pool->num_workers], fn, arg))
+    {
+        fn(arg);
+        finish_task(pool);
+        return;
+    }
+
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+void vm_pool_wait(vm_pool* pool)
+{
+    pthread_mutex_lock(&pool->idle_lock);
+    while (atomic_load(&pool->outstanding) != 0)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->idle_lock);
+    }
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+double vm_pool_stats(vm_pool* pool, int worker, vm_worker_stats* stats)
+{
+    double elapsed = now_ns() - pool->started_ns;
+
+    *stats = pool->queues[worker].stats;
+    return (elapsed > 0.0) ? stats->busy_ns / elapsed : 0.0;
+}
+
+void vm_pool_reset_stats(vm_pool* pool)
+{
+    int i;
+
+    for (i = 0; i < pool->num_workers; i++)
+    {
+        memset(&pool->queues[i].stats, 0, sizeof(vm_worker_stats));
+    }
+    pool->started_ns = now_ns();
+}
+
+void vm_pool_destroy(vm_pool* pool)
+{
+    stop_workers(pool, pool->num_workers);
+}
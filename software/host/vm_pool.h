@@ -0,0 +1,86 @@
+/*************************************************************************
+* Description:                                                           *
+* Work-stealing thread pool for running many voice streams on Linux.     *
+* Every worker owns a queue; a worker takes its own newest task first    *
+* and, when its queue is empty, steals the oldest task from another      *
+* worker.  Tasks submitted for one stream should always go to the same   *
+* worker so that stream keeps its cache affinity unless it is stolen.    *
+**************************************************************************/
+
+#ifndef VM_POOL_H_
+#define VM_POOL_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* Tasks per worker queue; must be a power of two */
+#define     VM_POOL_QUEUE_SIZE      4096
+
+
+typedef void (*vm_task_fn)(void* arg);
+
+typedef struct
+{
+    vm_task_fn fn;
+    void* arg;
+} vm_task;
+
+// counters for one worker; written only by that worker
+typedef struct
+{
+    long executed;          // tasks run, including stolen ones
+    long steals;            // tasks taken from another worker's queue
+    long steal_attempts;    // queues inspected while looking for work
+    double busy_ns;         // time spent running tasks
+} vm_worker_stats;
+
+typedef struct vm_pool vm_pool;
+
+typedef struct
+{
+    vm_pool* pool;
+    int index;
+    pthread_mutex_t lock;
+    vm_task tasks[VM_POOL_QUEUE_SIZE];
+    unsigned int head;      // oldest task, taken by thieves
+    unsigned int tail;      // one past the newest task, taken by the owner
+    vm_worker_stats stats;
+} vm_worker_queue;
+
+struct vm_pool
+{
+    int num_workers;
+    pthread_t* threads;
+    vm_worker_queue* queues;
+
+    pthread_mutex_t idle_lock;
+    pthread_cond_t work_cond;       // signalled when tasks are queued
+    pthread_cond_t done_cond;       // signalled when no tasks are outstanding
+    atomic_long queued;             // tasks sitting in queues
+    atomic_long outstanding;        // tasks submitted and not yet finished
+    int shutdown;
+    double started_ns;
+};
+
+
+// starts num_workers threads; returns 0 on success, -1 otherwise
+int vm_pool_init(vm_pool* pool, int num_workers);
+
+// queues fn(arg) on the given worker (taken modulo the worker count);
+// if that queue is full the task runs immediately on the calling thread
+void vm_pool_submit(vm_pool* pool, int worker, vm_task_fn fn, void* arg);
+
+// blocks until every submitted task has finished
+void vm_pool_wait(vm_pool* pool);
+
+// copies the counters of one worker and returns its utilization since init or the last reset, 0 to 1
+double vm_pool_stats(vm_pool* pool, int worker, vm_worker_stats* stats);
+
+// clears all counters; call only while the pool is idle
+void vm_pool_reset_stats(vm_pool* pool);
+
+// stops and joins the workers; outstanding tasks are finished first
+void vm_pool_destroy(vm_pool* pool);
+
+
+#endif /*VM_POOL_H_*/
@@ -0,0 +1,638 @@
+/*************************************************************************
+* Description:                                                           *
+* Segmented multi-stream recorder and its reader.                        *
+**************************************************************************/
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "vm_record.h"
+
+#define     RECORD_ALIGN        8
+#define     RECORD_PATH_BUFFER  (VM_RECORD_PATH_SIZE + 32)     // dir plus a segment file name
+
+
+static size_t block_size(int n)
+{
+    size_t size = sizeof(vm_record_block) + (size_t) n * sizeof(short);
+    return (size + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1);
+}
+
+static void segment_path(const vm_recorder* rec, uint64_t number, const char* suffix, char* path)
+{
+    snprintf(path, RECORD_PATH_BUFFER, "%s/seg-%08llu.%s", rec->dir, (unsigned long long) number, suffix);
+}
+
+// creates, sizes and maps a segment file into a free slot; runs on the background thread.
+// Returns 0 on success, -1 otherwise
+static int create_segment(vm_recorder* rec, vm_record_segment* seg, uint64_t number)
+{
+    char path[RECORD_PATH_BUFFER];
+    vm_record_segment_header* header;
+    int fd;
+
+    segment_path(rec, number, "vmr", path);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t) rec->segment_bytes) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    //populated up front so writers never take a page fault on a fresh page
+    seg->base = mmap(NULL, rec->segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (seg->base == MAP_FAILED)
+    {
+        unlink(path);
+        return -1;
+    }
+    seg->capacity = rec->segment_bytes;
+    seg->start_time = 0;
+    seg->next = NULL;
+    //writers is left alone: a stale writer may be about to back off from this slot
+    atomic_store(&seg->used, VM_RECORD_HEADER_SIZE);
+
+    header = (vm_record_segment_header*) seg->base;
+    memcpy(header->magic, VM_RECORD_SEGMENT_MAGIC, 8);
+    header->number = number;
+    header->window = rec->window;
+    return 0;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    const vm_record_index_entry* x = (const vm_record_index_entry*) a;
+    const vm_record_index_entry* y = (const vm_record_index_entry*) b;
+
+    if (x->stream != y->stream)
+        return (x->stream < y->stream) ? -1 : 1;
+    if (x->timestamp != y->timestamp)
+        return (x->timestamp < y->timestamp) ? -1 : 1;
+    return (x->offset < y->offset) ? -1 : (x->offset > y->offset);
+}
+
+// lists the committed blocks of a segment sorted by stream and time; returns the
+// number of entries, or -1 if out of memory
+static long scan_segment(const unsigned char* base, size_t used, vm_record_index_entry** entries)
+{
+    size_t offset = VM_RECORD_HEADER_SIZE;
+    size_t capacity = 64;
+    long count = 0;
+
+    *entries = malloc(capacity * sizeof(vm_record_index_entry));
+    if (*entries == NULL)
+    {
+        return -1;
+    }
+    while (offset + sizeof(vm_record_block) <= used)
+    {
+        const vm_record_block* block = (const vm_record_block*) (base + offset);
+        uint32_t size = __atomic_load_n(&block->size, __ATOMIC_ACQUIRE);
+
+        //an uncommitted or torn block ends the segment
+        if (size < sizeof(vm_record_block) || offset + size > used || size != block_size((int) block->count))
+        {
+            break;
+        }
+        if ((size_t) count == capacity)
+        {
+            vm_record_index_entry* grown = realloc(*entries, 2 * capacity * sizeof(vm_record_index_entry));
+            if (grown == NULL)
+            {
+                free(*entries);
+                *entries = NULL;
+                return -1;
+            }
+            *entries = grown;
+            capacity *= 2;
+        }
+        (*entries)[count].stream = block->stream;
+        (*entries)[count].reserved = 0;
+        (*entries)[count].timestamp = block->timestamp;
+        (*entries)[count].offset = offset;
+        count++;
+        offset += size;
+    }
+    qsort(*entries, count, sizeof(vm_record_index_entry), compare_entries);
+    return count;
+}
+
+// waits for the last writer, then trims, indexes and unmaps a segment; runs on the background thread
+static void retire_segment(vm_recorder* rec, vm_record_segment* seg)
+{
+    char path[RECORD_PATH_BUFFER];
+    char tmp_path[RECORD_PATH_BUFFER + 4];
+    vm_record_segment_header* header = (vm_record_segment_header*) seg->base;
+    vm_record_index_entry* entries;
+    size_t used;
+    long count;
+    FILE* f;
+
+    while (atomic_load(&seg->writers) != 0)
+    {
+        sched_yield();
+    }
+    used = atomic_load(&seg->used);
+    if (used > seg->capacity)
+    {
+        used = seg->capacity;
+    }
+
+    //blocks that were reserved past the end leave an uncommitted tail, which the scan stops at
+    count = scan_segment(seg->base, used, &entries);
+    if (count >= 0)
+    {
+        size_t end = VM_RECORD_HEADER_SIZE;
+        long i;
+        for (i = 0; i < count; i++)
+        {
+            const vm_record_block* block = (const vm_record_block*) (seg->base + entries[i].offset);
+            if (entries[i].offset + block->size > end)
+            {
+                end = entries[i].offset + block->size;
+            }
+        }
+        used = end;
+    }
+    header->used = used;
+    msync(seg->base, used, MS_ASYNC);
+    munmap(seg->base, seg->capacity);
+
+    segment_path(rec, seg->number, "vmr", path);
+    if (truncate(path, (off_t) used) != 0)
+    {
+        //harmless: readers stop at the zeroed tail
+        fprintf(stderr, "Warning: could not trim %s\n", path);
+    }
+    if (count >= 0)
+    {
+        //written under a temporary name so a reader never sees half an index
+        segment_path(rec, seg->number, "idx", path);
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+        f = fopen(tmp_path, "wb");
+        if (f != NULL)
+        {
+            uint64_t n = (uint64_t) count;
+            fwrite(VM_RECORD_INDEX_MAGIC, 1, 8, f);
+            fwrite(&n, sizeof(n), 1, f);
+            fwrite(entries, sizeof(vm_record_index_entry), count, f);
+            if (fclose(f) == 0)
+            {
+                rename(tmp_path, path);
+            }
+        }
+        free(entries);
+    }
+}
+
+static vm_record_segment* free_slot(vm_recorder* rec)
+{
+    int i;
+
+    for (i = 0; i < VM_RECORD_SLOTS; i++)
+    {
+        if (!rec->slots[i].in_use)
+        {
+            return &rec->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void* background_thread(void* arg)
+{
+    vm_recorder* rec = (vm_recorder*) arg;
+
+    pthread_mutex_lock(&rec->lock);
+    while (1)
+    {
+        if (rec->retiring != NULL)
+        {
+            vm_record_segment* seg = rec->retiring;
+            rec->retiring = seg->next;
+            pthread_mutex_unlock(&rec->lock);
+            retire_segment(rec, seg);
+            pthread_mutex_lock(&rec->lock);
+            seg->in_use = 0;
+        }
+        else if (rec->shutdown)
+        {
+            break;
+        }
+        else if (rec->spare == NULL && !rec->error && free_slot(rec) != NULL)
+        {
+            vm_record_segment* seg = free_slot(rec);
+            uint64_t number = rec->next_number++;
+            int result;
+
+            //number is set under the lock, where rotate compares it
+            seg->in_use = 1;
+            seg->number = number;
+            pthread_mutex_unlock(&rec->lock);
+            result = create_segment(rec, seg, number);
+            pthread_mutex_lock(&rec->lock);
+            if (result == 0)
+            {
+                rec->spare = seg;
+            }
+            else
+            {
+                seg->in_use = 0;
+                rec->error = 1;
+            }
+            pthread_cond_broadcast(&rec->cond);
+        }
+        else
+        {
+            pthread_cond_wait(&rec->cond, &rec->lock);
+        }
+    }
+    pthread_mutex_unlock(&rec->lock);
+    return NULL;
+}
+
+// whether old, as segment number, is still the current segment; under the lock
+static int is_current(vm_recorder* rec, vm_record_segment* old, uint64_t number)
+{
+    return atomic_load(&rec->current) == old && (old == NULL || old->number == number);
+}
+
+// swaps in the spare segment unless another writer already replaced segment number
+// of old; returns 0, or -1 on error
+static int rotate(vm_recorder* rec, vm_record_segment* old, uint64_t number, uint64_t timestamp)
+{
+    vm_record_segment* seg;
+    int result = 0;
+
+    pthread_mutex_lock(&rec->lock);
+    if (is_current(rec, old, number) && rec->spare == NULL && !rec->error)
+    {
+        atomic_fetch_add(&rec->stalls, 1);
+    }
+
+    //rechecked after every wait: another writer may rotate while we sleep
+    while (is_current(rec, old, number) && rec->spare == NULL && !rec->error)
+    {
+        pthread_cond_wait(&rec->cond, &rec->lock);
+    }
+    if (is_current(rec, old, number))
+    {
+        if (rec->spare == NULL)
+        {
+            result = -1;
+        }
+        else
+        {
+            seg = rec->spare;
+            rec->spare = NULL;
+            seg->start_time = (rec->window > 0) ? timestamp - timestamp % rec->window : timestamp;
+            ((vm_record_segment_header*) seg->base)->start_time = seg->start_time;
+            atomic_store(&rec->current, seg);
+            atomic_fetch_add(&rec->segments, 1);
+            if (old != NULL)
+            {
+                old->next = rec->retiring;
+                rec->retiring = old;
+            }
+            pthread_cond_broadcast(&rec->cond);
+        }
+    }
+    pthread_mutex_unlock(&rec->lock);
+    return result;
+}
+
+
+int vm_recorder_open(vm_recorder* rec, const char* dir, size_t segment_bytes, uint64_t window)
+{
+    int i;
+
+    memset(rec, 0, sizeof(*rec));
+    if (strlen(dir) + 20 >= VM_RECORD_PATH_SIZE || segment_bytes < VM_RECORD_HEADER_SIZE + sizeof(vm_record_block))
+    {
+        return -1;
+    }
+    strcpy(rec->dir, dir);
+    rec->segment_bytes = (segment_bytes + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1);
+    rec->window = window;
+    atomic_init(&rec->current, NULL);
+    for (i = 0; i < VM_RECORD_SLOTS; i++)
+    {
+        atomic_init(&rec->slots[i].used, 0);
+        atomic_init(&rec->slots[i].writers, 0);
+    }
+    pthread_mutex_init(&rec->lock, NULL);
+    pthread_cond_init(&rec->cond, NULL);
+    if (pthread_create(&rec->thread, NULL, background_thread, rec) != 0)
+    {
+        return -1;
+    }
+
+    //the first segment is ready before anyone writes, and a bad dir shows up here
+    pthread_mutex_lock(&rec->lock);
+    while (rec->spare == NULL && !rec->error)
+    {
+        pthread_cond_wait(&rec->cond, &rec->lock);
+    }
+    pthread_mutex_unlock(&rec->lock);
+    if (rec->error)
+    {
+        vm_recorder_close(rec);
+        return -1;
+    }
+    return 0;
+}
+
+int vm_recorder_write(vm_recorder* rec, uint32_t stream, uint64_t timestamp, int sample_rate,
+                      const short* samples, int n)
+{
+    size_t size = block_size(n);
+
+    if (n < 0 || size > rec->segment_bytes - VM_RECORD_HEADER_SIZE)
+    {
+        return -1;
+    }
+
+    while (1)
+    {
+        vm_record_segment* seg = atomic_load(&rec->current);
+        uint64_t number;
+
+        if (seg == NULL)
+        {
+            if (rotate(rec, NULL, 0, timestamp) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        //announce the write before checking the segment is still current, so
+        //retiring it waits for us or we see it has gone
+        atomic_fetch_add(&seg->writers, 1);
+        if (atomic_load(&rec->current) != seg)
+        {
+            atomic_fetch_sub(&seg->writers, 1);
+            continue;
+        }
+        number = seg->number;
+        if (rec->window == 0 || timestamp < seg->start_time + rec->window)
+        {
+            size_t offset = atomic_fetch_add(&seg->used, size);
+            if (offset + size <= seg->capacity)
+            {
+                vm_record_block* block = (vm_record_block*) (seg->base + offset);
+                block->stream = stream;
+                block->timestamp = timestamp;
+                block->count = (uint32_t) n;
+                block->sample_rate = (uint32_t) sample_rate;
+                block->reserved = 0;
+                memcpy(block + 1, samples, (size_t) n * sizeof(short));
+                __atomic_store_n(&block->size, (uint32_t) size, __ATOMIC_RELEASE);
+                atomic_fetch_sub(&seg->writers, 1);
+                atomic_fetch_add_explicit(&rec->blocks, 1, memory_order_relaxed);
+                atomic_fetch_add_explicit(&rec->bytes, (long) size, memory_order_relaxed);
+                return 0;
+            }
+        }
+        atomic_fetch_sub(&seg->writers, 1);
+
+        //full or out of its window
+        if (rotate(rec, seg, number, timestamp) != 0)
+        {
+            return -1;
+        }
+    }
+}
+
+void vm_recorder_close(vm_recorder* rec)
+{
+    vm_record_segment* seg;
+    char path[RECORD_PATH_BUFFER];
+
+    pthread_mutex_lock(&rec->lock);
+    seg = atomic_exchange(&rec->current, NULL);
+    if (seg != NULL)
+    {
+        seg->next = rec->retiring;
+        rec->retiring = seg;
+    }
+    rec->shutdown = 1;
+    pthread_cond_broadcast(&rec->cond);
+    pthread_mutex_unlock(&rec->lock);
+    pthread_join(rec->thread, NULL);
+
+    //the spare was never written to
+    if (rec->spare != NULL)
+    {
+        munmap(rec->spare->base, rec->spare->capacity);
+        segment_path(rec, rec->spare->number, "vmr", path);
+        unlink(path);
+        rec->spare->in_use = 0;
+        rec->spare = NULL;
+    }
+    pthread_cond_destroy(&rec->cond);
+    pthread_mutex_destroy(&rec->lock);
+}
+
+
+// loads a segment's index file; returns the entry count or -1 if it is missing or bad
+static long load_index(const char* path, vm_record_index_entry** entries)
+{
+    FILE* f = fopen(path, "rb");
+    char magic[8];
+    uint64_t n;
+
+    *entries = NULL;
+    if (f == NULL)
+    {
+        return -1;
+    }
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, VM_RECORD_INDEX_MAGIC, 8) != 0
+        || fread(&n, sizeof(n), 1, f) != 1
+        || (*entries = malloc((n > 0 ? n : 1) * sizeof(vm_record_index_entry))) == NULL
+        || fread(*entries, sizeof(vm_record_index_entry), n, f) != n)
+    {
+        free(*entries);
+        *entries = NULL;
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return (long) n;
+}
+
+int vm_record_reader_open(vm_record_reader* reader, const char* dir)
+{
+    char pattern[VM_RECORD_PATH_SIZE + 16];
+    glob_t files;
+    size_t i;
+
+    memset(reader, 0, sizeof(*reader));
+    snprintf(pattern, sizeof(pattern), "%s/seg-*.vmr", dir);
+    if (glob(pattern, 0, NULL, &files) != 0)
+    {
+        return -1;
+    }
+    reader->segments = calloc(files.gl_pathc, sizeof(vm_record_segment_view));
+    if (reader->segments == NULL)
+    {
+        globfree(&files);
+        return -1;
+    }
+
+    //glob sorts the names, and the zero-padded numbers sort in recording order
+    for (i = 0; i < files.gl_pathc; i++)
+    {
+        vm_record_segment_view* view = &reader->segments[reader->num_segments];
+        char index_path[VM_RECORD_PATH_SIZE + 16];
+        const vm_record_segment_header* header;
+        struct stat st;
+        long count;
+        int fd = open(files.gl_pathv[i], O_RDONLY);
+
+        if (fd < 0)
+            continue;
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < VM_RECORD_HEADER_SIZE)
+        {
+            close(fd);
+            continue;
+        }
+        view->size = (size_t) st.st_size;
+        view->base = mmap(NULL, view->size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view->base == MAP_FAILED)
+            continue;
+        header = (const vm_record_segment_header*) view->base;
+        if (memcmp(header->magic, VM_RECORD_SEGMENT_MAGIC, 8) != 0)
+        {
+            munmap(view->base, view->size);
+            continue;
+        }
+
+        //segments that were never closed have no index and are scanned instead
+        snprintf(index_path, sizeof(index_path), "%.*s.idx", (int) strlen(files.gl_pathv[i]) - 4, files.gl_pathv[i]);
+        count = (header->used != 0) ? load_index(index_path, &view->entries) : -1;
+        if (count < 0)
+        {
+            count = scan_segment(view->base, (header->used != 0) ? header->used : view->size, &view->entries);
+        }
+        if (count < 0)
+        {
+            munmap(view->base, view->size);
+            continue;
+        }
+        view->count = (size_t) count;
+        reader->num_segments++;
+    }
+    globfree(&files);
+    return 0;
+}
+
+// first entry not ordered before (stream, timestamp)
+static size_t lower_bound(const vm_record_segment_view* view, uint32_t stream, uint64_t timestamp)
+{
+    size_t low = 0, high = view->count;
+
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        const vm_record_index_entry* e = &view->entries[mid];
+        if (e->stream < stream || (e->stream == stream && e->timestamp < timestamp))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static const vm_record_block* entry_block(const vm_record_reader* reader, int segment, size_t entry)
+{
+    const vm_record_segment_view* view = &reader->segments[segment];
+    return (const vm_record_block*) (view->base + view->entries[entry].offset);
+}
+
+int vm_record_seek(const vm_record_reader* reader, uint32_t stream, uint64_t timestamp,
+                   vm_record_cursor* cursor)
+{
+    int before_segment = -1;
+    size_t before_entry = 0;
+    int s;
+
+    cursor->stream = stream;
+    for (s = 0; s < reader->num_segments; s++)
+    {
+        const vm_record_segment_view* view = &reader->segments[s];
+        size_t pos = lower_bound(view, stream, timestamp);
+
+        //the block playing at timestamp started before it, possibly in an earlier segment
+        if (pos > 0 && view->entries[pos - 1].stream == stream)
+        {
+            before_segment = s;
+            before_entry = pos - 1;
+        }
+        if (pos < view->count && view->entries[pos].stream == stream)
+        {
+            cursor->segment = s;
+            cursor->entry = pos;
+            if (view->entries[pos].timestamp == timestamp)
+            {
+                return 0;
+            }
+            break;
+        }
+    }
+
+    if (before_segment >= 0)
+    {
+        const vm_record_block* block = entry_block(reader, before_segment, before_entry);
+        uint64_t end = block->timestamp + (uint64_t) block->count * 1000000000ULL / block->sample_rate;
+        if (end > timestamp)
+        {
+            cursor->segment = before_segment;
+            cursor->entry = before_entry;
+            return 0;
+        }
+    }
+    return (s < reader->num_segments) ? 0 : -1;
+}
+
+const vm_record_block* vm_record_next(const vm_record_reader* reader, vm_record_cursor* cursor)
+{
+    while (cursor->segment < reader->num_segments)
+    {
+        const vm_record_segment_view* view = &reader->segments[cursor->segment];
+
+        if (cursor->entry < view->count && view->entries[cursor->entry].stream == cursor->stream)
+        {
+            return entry_block(reader, cursor->segment, cursor->entry++);
+        }
+
+        //the stream continues from the start of its entries in the next segment
+        if (++cursor->segment < reader->num_segments)
+        {
+            cursor->entry = lower_bound(&reader->segments[cursor->segment], cursor->stream, 0);
+        }
+    }
+    return NULL;
+}
+
+void vm_record_reader_close(vm_record_reader* reader)
+{
+    int s;
+
+    for (s = 0; s < reader->num_segments; s++)
+    {
+        munmap(reader->segments[s].base, reader->segments[s].size);
+        free(reader->segments[s].entries);
+    }
+    free(reader->segments);
+    memset(reader, 0, sizeof(*reader));
+}
@@ -0,0 +1,160 @@
+/*************************************************************************
+* Description:                                                           *
+* Append-only recording of processed audio for any number of streams.   *
+* All streams share one series of segment files in a directory, so      *
+* hundreds of streams need no file handles of their own.  Each segment   *
+* covers one time window (and is cut early if it fills up) and holds     *
+* blocks of the form                                                     *
+*     vm_record_block header, count samples, padding to 8 bytes          *
+* in the order they were written.                                        *
+*                                                                        *
+* Segments are created ahead of time, sized and mapped by a background   *
+* thread, so vm_recorder_write only reserves space with an atomic add    *
+* and copies into the mapping; it makes no system calls.  A block's      *
+* size is stored last, so a reader or a crash never sees half a block.   *
+* When a segment is retired the background thread trims the file, sorts  *
+* its blocks by stream and time into a .idx file next to it, and unmaps  *
+* it.  The reader seeks by stream and time with those indexes, and       *
+* rebuilds one by scanning if a segment was never closed.                *
+**************************************************************************/
+
+#ifndef VM_RECORD_H_
+#define VM_RECORD_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define     VM_RECORD_SEGMENT_MAGIC     "VMRSEG01"
+#define     VM_RECORD_INDEX_MAGIC       "VMRIDX01"
+#define     VM_RECORD_HEADER_SIZE       64      // segment header, before the first block
+#define     VM_RECORD_PATH_SIZE         256
+#define     VM_RECORD_SLOTS             8       // segments open at once: current, spare and retiring
+
+
+// header in front of every block's samples
+typedef struct
+{
+    uint32_t size;              // bytes including this header and padding; 0 until committed
+    uint32_t stream;
+    uint64_t timestamp;         // of the first sample, in ns, as given by the writer
+    uint32_t count;             // samples that follow
+    uint32_t sample_rate;
+    uint64_t reserved;
+} vm_record_block;
+
+// first VM_RECORD_HEADER_SIZE bytes of a segment file
+typedef struct
+{
+    char magic[8];
+    uint64_t number;
+    uint64_t start_time;        // start of the window the segment covers, in ns
+    uint64_t window;            // window length in ns, 0 if segments only roll when full
+    uint64_t used;              // bytes in use once closed, 0 while open
+} vm_record_segment_header;
+
+// one entry of a segment index, sorted by stream then timestamp
+typedef struct
+{
+    uint32_t stream;
+    uint32_t reserved;
+    uint64_t timestamp;
+    uint64_t offset;            // of the block within the segment
+} vm_record_index_entry;
+
+typedef struct vm_record_segment vm_record_segment;
+
+// a segment's state; slots are reused but never freed while recording, so a
+// writer holding a stale pointer can still safely find out it is stale
+struct vm_record_segment
+{
+    unsigned char* base;
+    size_t capacity;
+    uint64_t number;
+    uint64_t start_time;
+    atomic_size_t used;         // bytes reserved so far; may run past capacity
+    atomic_int writers;         // writers between reserving and committing
+    vm_record_segment* next;    // in the list waiting to be retired
+    int in_use;                 // under the recorder lock
+};
+
+typedef struct
+{
+    char dir[VM_RECORD_PATH_SIZE];
+    size_t segment_bytes;
+    uint64_t window;
+
+    _Atomic(vm_record_segment*) current;
+
+    // everything below is shared with the background thread under lock
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    vm_record_segment slots[VM_RECORD_SLOTS];
+    vm_record_segment* spare;   // created and mapped, ready to become current
+    vm_record_segment* retiring;
+    uint64_t next_number;
+    int shutdown;
+    int error;
+
+    atomic_long blocks;
+    atomic_long bytes;
+    atomic_long segments;
+    atomic_long stalls;         // writers that had to wait for a spare segment
+} vm_recorder;
+
+typedef struct
+{
+    unsigned char* base;
+    size_t size;
+    vm_record_index_entry* entries;
+    size_t count;
+} vm_record_segment_view;
+
+typedef struct
+{
+    vm_record_segment_view* segments;
+    int num_segments;
+} vm_record_reader;
+
+// position of a stream within a reader
+typedef struct
+{
+    uint32_t stream;
+    int segment;
+    size_t entry;
+} vm_record_cursor;
+
+
+// starts recording into dir, which must exist, in segments of segment_bytes
+// covering window ns each (0 to only roll when full); returns 0 on success, -1 otherwise
+int vm_recorder_open(vm_recorder* rec, const char* dir, size_t segment_bytes, uint64_t window);
+
+// appends n samples of stream starting at timestamp ns; safe from any number of
+// threads at once, but each stream's blocks must come from one thread in time order.
+// Returns 0 on success, -1 if the block does not fit a segment or no segment could be made
+int vm_recorder_write(vm_recorder* rec, uint32_t stream, uint64_t timestamp, int sample_rate,
+                      const short* samples, int n);
+
+// retires the current segment, indexes everything and stops the background thread
+void vm_recorder_close(vm_recorder* rec);
+
+// maps every segment in dir and loads or rebuilds its index; returns 0 on success, -1 otherwise
+int vm_record_reader_open(vm_record_reader* reader, const char* dir);
+
+// positions cursor at the block of stream playing at timestamp, or the first one
+// after it; returns 0 on success, -1 if the stream has nothing from then on
+int vm_record_seek(const vm_record_reader* reader, uint32_t stream, uint64_t timestamp,
+                   vm_record_cursor* cursor);
+
+// returns the block at cursor and advances it, or NULL after the stream's last block
+const vm_record_block* vm_record_next(const vm_record_reader* reader, vm_record_cursor* cursor);
+
+// the samples that follow a block header
+#define     vm_record_samples(block)    ((const short*) ((const vm_record_block*) (block) + 1))
+
+void vm_record_reader_close(vm_record_reader* reader);
+
+
+#endif /*VM_RECORD_H_*/
@@ -0,0 +1,134 @@
+/*************************************************************************
+* Description:                                                           *
+* Allocation and sleeping for the SPSC block ring; the hot-path          *
+* operations are inline in vm_ring.h.                                    *
+*                                                                        *
+* The consumer announces that it is going to sleep and then re-checks    *
+* the ring, while the producer publishes a block and then checks for a   *
+* sleeper; the sequentially consistent fences on both sides guarantee    *
+* that at least one of them sees the other, so no wakeup is lost.        *
+**************************************************************************/
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "vm_ring.h"
+
+
+int vm_ring_init(vm_ring* ring, unsigned int capacity)
+{
+    unsigned int size = 1;
+    size_t bytes;
+
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->sleeping, 0);
+    ring->event_fd = -1;
+    //aligned_alloc needs the size to be a multiple of the alignment
+    bytes = (size * sizeof(vm_block*) + VM_CACHE_LINE - 1) & ~(size_t) (VM_CACHE_LINE - 1);
+    ring->slots = aligned_alloc(VM_CACHE_LINE, bytes);
+    if (ring->slots == NULL)
+    {
+        return -1;
+    }
+    ring->mask = size - 1;
+    return 0;
+}
+
+void vm_ring_free(vm_ring* ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+    if (ring->event_fd >= 0)
+    {
+        close(ring->event_fd);
+        ring->event_fd = -1;
+    }
+}
+
+int vm_ring_enable_events(vm_ring* ring, unsigned int watermark)
+{
+    if (watermark == 0 || watermark > ring->mask + 1)
+    {
+        return -1;
+    }
+    ring->event_fd = eventfd(0, 0);
+    if (ring->event_fd < 0)
+    {
+        return -1;
+    }
+    ring->watermark = watermark;
+    return 0;
+}
+
+static unsigned int queued(vm_ring* ring)
+{
+    return atomic_load_explicit(&ring->tail, memory_order_seq_cst)
+         - atomic_load_explicit(&ring->head, memory_order_seq_cst);
+}
+
+void vm_ring_wake(vm_ring* ring, int force)
+{
+    uint64_t one = 1;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (force)
+    {
+        //the consumer may be between its re-check and its read, so post even if
+        //it does not look asleep yet
+        if (queued(ring) == 0)
+        {
+            return;
+        }
+        atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+        if (write(ring->event_fd, &one, sizeof(one)) < 0)
+        {
+            return;
+        }
+    }
+    else if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed)
+             && queued(ring) >= ring->watermark
+             && atomic_exchange_explicit(&ring->sleeping, 0, memory_order_relaxed))
+    {
+        if (write(ring->event_fd, &one, sizeof(one)) < 0)
+        {
+            return;
+        }
+    }
+}
+
+vm_block* vm_ring_pop_wait(vm_ring* ring)
+{
+    vm_block* block;
+    uint64_t count;
+
+    while ((block = vm_ring_pop(ring)) == NULL)
+    {
+        if (ring->event_fd < 0)
+        {
+            sched_yield();
+            continue;
+        }
+
+        atomic_store_explicit(&ring->sleeping, 1, memory_order_seq_cst);
+        if (queued(ring) >= ring->watermark)
+        {
+            atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+            continue;
+        }
+        if (read(ring->event_fd, &count, sizeof(count)) == sizeof(count))
+        {
+            ring->wakeups++;
+        }
+    }
+    return block;
+}
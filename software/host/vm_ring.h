@@ -0,0 +1,116 @@
+/*************************************************************************
+* Description:                                                           *
+* Lock-free single-producer/single-consumer ring of audio block          *
+* pointers, used to hand whole blocks between pipeline stages running    *
+* on different threads.  The producer and consumer indices live on       *
+* separate cache lines, and each side keeps a private copy of the other  *
+* side's index so it only touches the shared line when the ring looks    *
+* full or empty.                                                         *
+*                                                                        *
+* Only pointers pass through the ring: a block handed on with            *
+* vm_ring_push belongs to the consumer that pops it, and its samples     *
+* are never copied.                                                      *
+*                                                                        *
+* A consumer that has nothing to do can sleep on an eventfd instead of   *
+* spinning: after vm_ring_enable_events, vm_ring_pop_wait blocks until   *
+* watermark blocks are queued, and the producer only makes the wakeup    *
+* system call when the consumer is actually asleep.                      *
+**************************************************************************/
+
+#ifndef VM_RING_H_
+#define VM_RING_H_
+
+#include <stdatomic.h>
+#include "../vm_engine.h"
+
+#define     VM_CACHE_LINE       64
+
+
+typedef struct vm_block vm_block;
+
+typedef struct
+{
+    // written by the producer
+    _Alignas(VM_CACHE_LINE) atomic_uint tail;
+    unsigned int cached_head;
+    long full_events;               // times the producer found the ring full
+    long overruns;                  // blocks the producer dropped instead of waiting
+
+    // written by the consumer
+    _Alignas(VM_CACHE_LINE) atomic_uint head;
+    unsigned int cached_tail;
+    long empty_events;              // times the consumer found the ring empty
+    long wakeups;                   // times the consumer slept and was woken
+
+    // consumer sleep state, shared by both sides
+    _Alignas(VM_CACHE_LINE) atomic_int sleeping;
+
+    // read-only after init
+    _Alignas(VM_CACHE_LINE) unsigned int mask;
+    vm_block** slots;
+    int event_fd;                   // -1 unless events are enabled
+    unsigned int watermark;         // blocks that must be queued to wake the consumer
+} vm_ring;
+
+
+// allocates a ring of capacity blocks (rounded up to a power of two); returns 0 on success
+int vm_ring_init(vm_ring* ring, unsigned int capacity);
+
+void vm_ring_free(vm_ring* ring);
+
+// lets the consumer sleep until watermark blocks are queued; returns 0 on success
+int vm_ring_enable_events(vm_ring* ring, unsigned int watermark);
+
+// producer: wakes a sleeping consumer if the watermark is met, or if anything
+// is queued when force is set, e.g. at the end of a batch or of the stream
+void vm_ring_wake(vm_ring* ring, int force);
+
+// consumer: takes the oldest block, sleeping or yielding until there is one
+vm_block* vm_ring_pop_wait(vm_ring* ring);
+
+
+// producer: hands block to the consumer; returns 0 on success, -1 if the ring is full
+static inline int vm_ring_push(vm_ring* ring, vm_block* block)
+{
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail - ring->cached_head > ring->mask)
+    {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask)
+        {
+            ring->full_events++;
+            return -1;
+        }
+    }
+    ring->slots[tail & ring->mask] = block;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    if (ring->event_fd >= 0)
+    {
+        vm_ring_wake(ring, 0);
+    }
+    return 0;
+}
+
+// consumer: takes the oldest block, or returns NULL if the ring is empty
+static inline vm_block* vm_ring_pop(vm_ring* ring)
+{
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    vm_block* block;
+
+    if (head == ring->cached_tail)
+    {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail)
+        {
+            ring->empty_events++;
+            return NULL;
+        }
+    }
+    block = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return block;
+}
+
+
+#endif /*VM_RING_H_*/
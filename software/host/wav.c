@@ -0,0 +1,403 @@
+/*************************************************************************
+* Description:                                                           *
+* Minimal 16-bit PCM WAV reader and writer.  Unknown chunks are skipped; *
+* only uncompressed 16-bit data is accepted.                             *
+**************************************************************************/
+
+//madvise is not POSIX, so glibc hides it under -std=c99 without this
+#define     _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wav.h"
+
+#define     WAV_HEADER_SIZE     44
+#define     WAV_READ_CHUNK      256
+
+
+static unsigned int get_le16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_le32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static void put_le16(unsigned char* p, unsigned int value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+}
+
+static void put_le32(unsigned char* p, unsigned int value)
+{
+    put_le16(p, value & 0xffff);
+    put_le16(p + 2, value >> 16);
+}
+
+static void write_header(wav_file* wav)
+{
+    unsigned char header[WAV_HEADER_SIZE];
+    unsigned int frame_bytes = 2 * wav->channels;
+    unsigned int data_bytes = (unsigned int) wav->frames * frame_bytes;
+
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, 1);                       // PCM
+    put_le16(header + 22, wav->channels);
+    put_le32(header + 24, wav->sample_rate);
+    put_le32(header + 28, wav->sample_rate * frame_bytes);  // byte rate
+    put_le16(header + 32, frame_bytes);                     // block align
+    put_le16(header + 34, 16);                      // bits per sample
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, data_bytes);
+
+    fseek(wav->file, 0, SEEK_SET);
+    fwrite(header, 1, WAV_HEADER_SIZE, wav->file);
+}
+
+
+int wav_open_read(wav_file* wav, const char* path)
+{
+    unsigned char chunk[8];
+    unsigned char fmt[16];
+    int have_fmt = 0;
+
+    memset(wav, 0, sizeof(*wav));
+    wav->file = fopen(path, "rb");
+    if (wav->file == NULL)
+    {
+        return -1;
+    }
+
+    if (fread(chunk, 1, 8, wav->file) != 8 || memcmp(chunk, "RIFF", 4) != 0
+        || fread(chunk, 1, 4, wav->file) != 4 || memcmp(chunk, "WAVE", 4) != 0)
+    {
+        wav_close(wav);
+        return -1;
+    }
+
+    //walk the chunk list until the data chunk is found
+    while (fread(chunk, 1, 8, wav->file) == 8)
+    {
+        unsigned int size = get_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+        {
+            if (fread(fmt, 1, 16, wav->file) != 16)
+            {
+                break;
+            }
+            fseek(wav->file, size - 16 + (size & 1), SEEK_CUR);
+            wav->channels = get_le16(fmt + 2);
+            wav->sample_rate = get_le32(fmt + 4);
+            have_fmt = (get_le16(fmt) == 1 && get_le16(fmt + 14) == 16 && wav->channels > 0);
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!have_fmt)
+            {
+                break;
+            }
+            wav->frames = size / (2 * wav->channels);
+            return 0;
+        }
+        else
+        {
+            fseek(wav->file, size + (size & 1), SEEK_CUR);
+        }
+    }
+
+    wav_close(wav);
+    return -1;
+}
+
+int wav_read_mono(wav_file* wav, short* samples, int max_frames)
+{
+    short frame_buf[WAV_READ_CHUNK * 8];
+    int max_chunk = (int) (sizeof(frame_buf) / sizeof(short)) / wav->channels;
+    int total = 0;
+
+    if (max_frames > wav->frames)
+    {
+        max_frames = (int) wav->frames;
+    }
+
+    while (total < max_frames)
+    {
+        unsigned char* bytes = (unsigned char*) frame_buf;
+        int want = max_frames - total;
+        int got, i;
+
+        if (want > max_chunk)
+        {
+            want = max_chunk;
+        }
+        got = (int) fread(frame_buf, 2 * wav->channels, want, wav->file);
+        for (i = 0; i < got; i++)
+        {
+            samples[total + i] = (short) get_le16(bytes + 2 * wav->channels * i);
+        }
+        total += got;
+        if (got < want)
+        {
+            break;
+        }
+    }
+
+    wav->frames -= total;
+    return total;
+}
+
+static int open_write(wav_file* wav, const char* path, int sample_rate, int channels)
+{
+    memset(wav, 0, sizeof(*wav));
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL)
+    {
+        return -1;
+    }
+    wav->sample_rate = sample_rate;
+    wav->channels = channels;
+    wav->writing = 1;
+
+    //placeholder header; sizes are patched in wav_close
+    write_header(wav);
+    return 0;
+}
+
+int wav_open_write(wav_file* wav, const char* path, int sample_rate)
+{
+    return open_write(wav, path, sample_rate, 1);
+}
+
+int wav_open_write_stereo(wav_file* wav, const char* path, int sample_rate)
+{
+    return open_write(wav, path, sample_rate, 2);
+}
+
+int wav_open_write_raw(wav_file* wav, const char* path, int sample_rate)
+{
+    memset(wav, 0, sizeof(*wav));
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL)
+    {
+        return -1;
+    }
+    wav->sample_rate = sample_rate;
+    wav->channels = 1;
+    wav->writing = 1;
+    wav->raw = 1;
+    return 0;
+}
+
+int wav_write_mono(wav_file* wav, const short* samples, int n)
+{
+    unsigned char bytes[WAV_READ_CHUNK * 2];
+    int done = 0;
+
+    while (done < n)
+    {
+        int count = n - done;
+        int i;
+
+        if (count > WAV_READ_CHUNK)
+        {
+            count = WAV_READ_CHUNK;
+        }
+        for (i = 0; i < count; i++)
+        {
+            put_le16(bytes + 2 * i, (unsigned short) samples[done + i]);
+        }
+        if (fwrite(bytes, 2, count, wav->file) != (size_t) count)
+        {
+            return -1;
+        }
+        done += count;
+    }
+
+    wav->frames += n;
+    return 0;
+}
+
+int wav_write_stereo(wav_file* wav, const short* left, const short* right, int n)
+{
+    unsigned char bytes[WAV_READ_CHUNK * 4];
+    int done = 0;
+
+    while (done < n)
+    {
+        int count = n - done;
+        int i;
+
+        if (count > WAV_READ_CHUNK)
+        {
+            count = WAV_READ_CHUNK;
+        }
+        for (i = 0; i < count; i++)
+        {
+            put_le16(bytes + 4 * i, (unsigned short) left[done + i]);
+            put_le16(bytes + 4 * i + 2, (unsigned short) right[done + i]);
+        }
+        if (fwrite(bytes, 4, count, wav->file) != (size_t) count)
+        {
+            return -1;
+        }
+        done += count;
+    }
+
+    wav->frames += n;
+    return 0;
+}
+
+void wav_close(wav_file* wav)
+{
+    if (wav->file == NULL)
+    {
+        return;
+    }
+    if (wav->writing && !wav->raw)
+    {
+        write_header(wav);
+    }
+    fclose(wav->file);
+    wav->file = NULL;
+}
+
+// maps the whole file; the caller fills in the format
+static int map_file(wav_map* map, const char* path)
+{
+    struct stat st;
+    int fd;
+
+    memset(map, 0, sizeof(*map));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+    map->size = (size_t) st.st_size;
+    map->base = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map->base == MAP_FAILED)
+    {
+        map->base = NULL;
+        return -1;
+    }
+
+    //the file is read once from front to back
+    madvise(map->base, map->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+int wav_map_open(wav_map* map, const char* path)
+{
+    const unsigned char* p;
+    const unsigned char* end;
+    int have_fmt = 0;
+
+    if (map_file(map, path) != 0)
+    {
+        return -1;
+    }
+    p = (const unsigned char*) map->base;
+    end = p + map->size;
+    if (map->size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+    {
+        wav_map_close(map);
+        return -1;
+    }
+
+    //walk the chunk list until the data chunk is found
+    for (p += 12; end - p >= 8; )
+    {
+        unsigned int size = get_le32(p + 4);
+        const unsigned char* body = p + 8;
+
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && end - body >= 16)
+        {
+            map->channels = get_le16(body + 2);
+            map->sample_rate = get_le32(body + 4);
+            have_fmt = (get_le16(body) == 1 && get_le16(body + 14) == 16 && map->channels > 0);
+        }
+        else if (memcmp(p, "data", 4) == 0)
+        {
+            if (!have_fmt)
+            {
+                break;
+            }
+            //a recorder that was cut off may leave a size past the end of the file
+            if ((size_t) (end - body) < size)
+            {
+                size = (unsigned int) (end - body);
+            }
+            map->data = body;
+            map->frames = size / (2 * map->channels);
+            return 0;
+        }
+        if ((size_t) (end - body) < (size_t) size + (size & 1))
+        {
+            break;
+        }
+        p = body + size + (size & 1);
+    }
+
+    wav_map_close(map);
+    return -1;
+}
+
+int wav_map_open_raw(wav_map* map, const char* path, int sample_rate, int channels)
+{
+    if (channels <= 0 || map_file(map, path) != 0)
+    {
+        return -1;
+    }
+    map->data = (const unsigned char*) map->base;
+    map->sample_rate = sample_rate;
+    map->channels = channels;
+    map->frames = (long) (map->size / (2 * channels));
+    return 0;
+}
+
+int wav_map_read_mono(const wav_map* map, long first, short* samples, int n)
+{
+    const unsigned char* p;
+    size_t frame_bytes = 2 * (size_t) map->channels;
+    int i;
+
+    if (first >= map->frames)
+    {
+        return 0;
+    }
+    if (n > map->frames - first)
+    {
+        n = (int) (map->frames - first);
+    }
+    p = map->data + first * frame_bytes;
+    for (i = 0; i < n; i++)
+    {
+        samples[i] = (short) get_le16(p + i * frame_bytes);
+    }
+    return n;
+}
+
+void wav_map_close(wav_map* map)
+{
+    if (map->base != NULL)
+    {
+        munmap(map->base, map->size);
+    }
+    memset(map, 0, sizeof(*map));
+}
@@ -0,0 +1,78 @@
+/*************************************************************************
+* Description:                                                           *
+* Minimal reader and writer for 16-bit PCM WAV files, used by the host   *
+* tools to feed recorded audio through the Voice Manipulator engine.     *
+* Files can also be memory-mapped for reading, which lets batch jobs     *
+* walk large archives without copying them through stdio, and headerless *
+* raw 16-bit little-endian PCM can be read and written as well.          *
+**************************************************************************/
+
+#ifndef WAV_H_
+#define WAV_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+
+typedef struct
+{
+    FILE* file;
+    int sample_rate;
+    int channels;
+    long frames;        // frames remaining when reading, frames written when writing
+    int writing;
+    int raw;            // no header, e.g. raw PCM from a call recorder
+} wav_file;
+
+// a whole file mapped into memory for reading
+typedef struct
+{
+    void* base;
+    size_t size;
+    const unsigned char* data;      // first byte of the first frame
+    int sample_rate;
+    int channels;
+    long frames;
+} wav_map;
+
+
+// opens a 16-bit PCM WAV file for reading; returns 0 on success, -1 otherwise
+int wav_open_read(wav_file* wav, const char* path);
+
+// reads up to max_frames frames, keeping only the first channel; returns frames read
+int wav_read_mono(wav_file* wav, short* samples, int max_frames);
+
+// creates a mono 16-bit PCM WAV file; returns 0 on success, -1 otherwise
+int wav_open_write(wav_file* wav, const char* path, int sample_rate);
+
+// creates a stereo 16-bit PCM WAV file; returns 0 on success, -1 otherwise
+int wav_open_write_stereo(wav_file* wav, const char* path, int sample_rate);
+
+// appends n mono samples; returns 0 on success, -1 otherwise
+int wav_write_mono(wav_file* wav, const short* samples, int n);
+
+// appends n stereo frames from separate channel buffers, which may be the same
+// buffer; returns 0 on success, -1 otherwise
+int wav_write_stereo(wav_file* wav, const short* left, const short* right, int n);
+
+// creates a headerless 16-bit little-endian mono file; returns 0 on success, -1 otherwise
+int wav_open_write_raw(wav_file* wav, const char* path, int sample_rate);
+
+// closes the file, patching the header sizes if it was opened for writing
+void wav_close(wav_file* wav);
+
+
+// maps a 16-bit PCM WAV file read-only; returns 0 on success, -1 otherwise
+int wav_map_open(wav_map* map, const char* path);
+
+// maps a headerless 16-bit little-endian file of the given format; returns 0 on success, -1 otherwise
+int wav_map_open_raw(wav_map* map, const char* path, int sample_rate, int channels);
+
+// copies the first channel of up to n frames starting at frame first; returns frames copied
+int wav_map_read_mono(const wav_map* map, long first, short* samples, int n);
+
+// unmaps the file
+void wav_map_close(wav_map* map);
+
+
+#endif /*WAV_H_*/
@@ -0,0 +1,217 @@
+/*************************************************************************
+* Description:                                                           *
+* Linux test driver for the block engine.  Streams a WAV file through    *
+* vm_process_block and reports the per-block processing cost.            *
+*                                                                        *
+* Usage: wavproc [-s sin_step] [-c cos_step] [-f shift_hz]               *
+*                [-d echo_delay] [-e echo_decay] [-t delay:gain]...      *
+*                [-b block_size] [-k kernel] [-F order:fft_size]         *
+*                [-L gain:threshold] in.wav out.wav                      *
+* Parameters use the same encoding as params[] in main.c; -f overrides   *
+* the table steps with a shift in Hz (positive is up).  The kernel       *
+* is one of scalar, sse2, avx2 or neon; the default is the fastest one.  *
+* Each -t adds an echo tap after the -d one, with its delay in samples   *
+* and its gain in Q15; the echo ring is grown to fit the longest tap.    *
+* -F replaces the Hilbert FIR with an overlap-save FFT filter of any     *
+* even order; a fft_size of 0 picks the cheapest transform size.         *
+* -L applies a Q15 gain (32768 is unity, up to 8 times that) and limits  *
+* the peaks to threshold; the output is VM_LIMITER_LATENCY samples late. *
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wav.h"
+#include "../vm_engine.h"
+#include "../hilbert.h"
+
+#define     MAX_BLOCK_SIZE      8192
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int kernel_by_name(const char* name)
+{
+    if (strcmp(name, "scalar") == 0)
+        return HILBERT_KERNEL_SCALAR;
+    if (strcmp(name, "sse2") == 0)
+        return HILBERT_KERNEL_SSE2;
+    if (strcmp(name, "avx2") == 0)
+        return HILBERT_KERNEL_AVX2;
+    if (strcmp(name, "neon") == 0)
+        return HILBERT_KERNEL_NEON;
+    return -1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: wavproc [-s sin_step] [-c cos_step] [-f shift_hz] [-d echo_delay] [-e echo_decay] [-t delay:gain]... [-b block_size] [-k kernel] [-F order:fft_size] [-L gain:threshold] in.wav out.wav\n");
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    // same defaults as params[] in main.c
+    int params[10] = {1,109,4095,0,0,0};
+    int block_size = VM_BLOCK_SIZE;
+    int shift_hz = 0, have_shift_hz = 0;
+    vm_delay_tap taps[VM_DELAY_MAX_TAPS];
+    int num_taps = 0;
+    unsigned int ring_size = VM_ECHO_BUFFER_SIZE;
+    short* ring = NULL;
+    int fft_order = 0, fft_size = 0;
+    vm_fft_shifter fft;
+    void* fft_storage = NULL;
+    int limit_gain = 0, limit_threshold = 0;
+    vm_limiter limiter;
+    static short buf[MAX_BLOCK_SIZE];
+    static vm_engine engine;
+    wav_file in, out;
+    double elapsed = 0.0, worst = 0.0;
+    long blocks = 0, samples = 0;
+    int i, n;
+
+    for (i = 1; i < argc - 2; i += 2)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+            params[4] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            params[5] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-f") == 0)
+        {
+            shift_hz = atoi(argv[i+1]);
+            have_shift_hz = 1;
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+            params[2] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-e") == 0)
+            params[3] = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-t") == 0 && num_taps < VM_DELAY_MAX_TAPS - 1)
+        {
+            if (sscanf(argv[i+1], "%d:%d", &taps[num_taps].delay, &taps[num_taps].gain) != 2
+                || taps[num_taps].delay < 0)
+                usage();
+            num_taps++;
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+            block_size = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-k") == 0)
+        {
+            if (hilbert_set_kernel(kernel_by_name(argv[i+1])) != 0)
+            {
+                fprintf(stderr, "Error: kernel %s is not available\n", argv[i+1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-F") == 0)
+        {
+            if (sscanf(argv[i+1], "%d:%d", &fft_order, &fft_size) != 2 || fft_order <= 0)
+                usage();
+        }
+        else if (strcmp(argv[i], "-L") == 0)
+        {
+            if (sscanf(argv[i+1], "%d:%d", &limit_gain, &limit_threshold) != 2 || limit_threshold <= 0)
+                usage();
+        }
+        else
+            usage();
+    }
+    if (i != argc - 2 || block_size <= 0 || block_size > MAX_BLOCK_SIZE)
+        usage();
+
+    if (wav_open_read(&in, argv[argc-2]) != 0)
+    {
+        fprintf(stderr, "Error: could not read %s as 16-bit PCM WAV\n", argv[argc-2]);
+        return 1;
+    }
+    if (wav_open_write(&out, argv[argc-1], in.sample_rate) != 0)
+    {
+        fprintf(stderr, "Error: could not create %s\n", argv[argc-1]);
+        wav_close(&in);
+        return 1;
+    }
+
+    vm_engine_init(&engine);
+    vm_engine_set_params(&engine, params);
+    if (have_shift_hz)
+        vm_engine_set_shift_hz(&engine, shift_hz, in.sample_rate);
+    if (num_taps > 0)
+    {
+        for (i = 0; i < num_taps; i++)
+        {
+            while ((unsigned int) taps[i].delay >= ring_size)
+                ring_size *= 2;
+        }
+        ring = malloc(ring_size * sizeof(short));
+        if (ring == NULL || vm_engine_set_echo_storage(&engine, ring, ring_size) != 0)
+        {
+            fprintf(stderr, "Error: could not allocate a %u sample echo ring\n", ring_size);
+            return 1;
+        }
+        for (i = 0; i < num_taps; i++)
+            vm_delay_set_tap(&engine.echo, i + 1, taps[i].delay, taps[i].gain);
+    }
+    if (fft_order > 0)
+    {
+        if (fft_size == 0)
+            fft_size = vm_fft_shifter_best_size(fft_order, VM_FFT_MAX_SIZE);
+        fft_storage = (fft_size > 0) ? malloc(VM_FFT_SHIFTER_STORAGE(fft_size)) : NULL;
+        if (fft_storage == NULL || vm_fft_shifter_init(&fft, fft_storage, fft_order, fft_size, NULL) != 0)
+        {
+            fprintf(stderr, "Error: no order %d filter with a %d point transform\n", fft_order, fft_size);
+            return 1;
+        }
+        vm_engine_set_fft_shifter(&engine, &fft);
+    }
+    if (limit_threshold > 0)
+    {
+        vm_limiter_init(&limiter, limit_threshold, VM_LIMITER_RELEASE);
+        vm_limiter_set_gain(&limiter, limit_gain);
+        vm_engine_set_limiter(&engine, &limiter);
+    }
+
+    while ((n = wav_read_mono(&in, buf, block_size)) > 0)
+    {
+        double start = now_ns();
+        vm_process_block(&engine, buf, buf, n);
+        double cost = now_ns() - start;
+
+        elapsed += cost;
+        if (cost > worst)
+            worst = cost;
+        blocks++;
+        samples += n;
+
+        if (wav_write_mono(&out, buf, n) != 0)
+        {
+            fprintf(stderr, "Error: write to %s failed\n", argv[argc-1]);
+            break;
+        }
+    }
+
+    wav_close(&in);
+    wav_close(&out);
+    free(ring);
+    free(fft_storage);
+
+    if (blocks > 0)
+    {
+        if (fft_order > 0)
+            printf("%ld samples at %d Hz in %ld blocks of %d, order %d FFT Hilbert filter, %d points, %d samples late\n",
+                   samples, in.sample_rate, blocks, block_size, fft_order, fft_size, fft.block);
+        else
+            printf("%ld samples at %d Hz in %ld blocks of %d, %s Hilbert kernel\n",
+                   samples, in.sample_rate, blocks, block_size, hilbert_kernel_name());
+        printf("mean %.0f ns/block, worst %.0f ns/block, %.1f ns/sample\n",
+               elapsed / blocks, worst, elapsed / samples);
+        printf("%.0fx real time\n", (samples * 1e9 / in.sample_rate) / elapsed);
+    }
+    return 0;
+}
@@ -18,11 +18,16 @@
 #include "altera_avalon_fifo_util.h"
 #include "altera_avalon_fifo_regs.h"
 #include "altera_avalon_pio_regs.h"
-#include "samples.h"
+#include "sys/alt_timestamp.h"
+#include "vm_engine.h"
+#include "vm_params.h"
+#include "vm_ramp.h"
+#include "vm_resample.h"
+#include "vm_stats.h"
 
 
 /* Definition of Task Stacks and priorities */
-#define     AUDIO_DATA_TASK_STACKSIZE   65536
+#define     AUDIO_DATA_TASK_STACKSIZE   8192
 #define     LCD_TASK_STACKSIZE          2084
 #define     BT_TASK_STACKSIZE           2048
 #define     AUDIO_DATA_TASK_PRIORITY    3
@@ -32,10 +37,25 @@ OS_STK      audio_data_task_stk[AUDIO_DATA_TASK_STACKSIZE];
 OS_STK      LCD_task_stk[LCD_TASK_STACKSIZE];
 OS_STK      BT_task_stk[BT_TASK_STACKSIZE];
 OS_EVENT    *LCDSem;
+OS_EVENT    *AudioSem;
 
 /* Other defines */
-#define     AUDIO_BUFFER_SIZE   128
-#define     ECHO_BUFFER_SIZE 	4096
+#define     AUDIO_BUFFER_SIZE   VM_BLOCK_SIZE
+#define     AUDIO_DECIMATION    4
+#define     AUDIO_MIN_READ      32
+#define     AUDIO_WAIT_TICKS    10
+#define     AUDIO_FIFO_DEPTH    128
+
+/* Audio path statistics, written only by audio_data_task and printed by BT_task */
+#define     AUDIO_STAGE_DECIMATE    0
+#define     AUDIO_STAGE_PROCESS     1
+#define     AUDIO_STAGE_OUTPUT      2
+#define     AUDIO_STATS_PERIOD      50      // BT_task loops, 100ms each
+static vm_stats audio_stats;
+
+/* Echo ring, 8s at 8kHz; with no SDRAM on the board .bss is linked into the SRAM */
+#define     ECHO_RING_SIZE      65536
+static short echo_ring[ECHO_RING_SIZE];
 
 #define     FREQ_SHIFT_P3_4     11
 #define     FREQ_SHIFT_P2_4     -7
@@ -54,12 +74,15 @@ OS_EVENT    *LCDSem;
 #define     MIN_VOLUME			91
 #define     MAX_VOLUME			127
 #define     VOLUME_SHIFT		3
+#define     VOLUME_STEP_GAIN    23198   // one VOLUME_SHIFT of codec attenuation, -3dB in Q15
+#define     VOLUME_RAMP_SAMPLES 64      // exponential time constant of a volume change, 8ms at 8kHz
 #define     MAX_ECHO_NEG_DELAY	4095
 #define     MIN_ECHO_NEG_DELAY	95
 #define     ECHO_DELAY_SHIFT	800
+#define     MAX_ECHO_DECAY		24576
+#define     ECHO_DECAY_SHIFT	8192
 
 #define     NUM_BUTTONS			4
-#define     NUM_SINE_SAMPLES	320
 
 
 
@@ -77,19 +100,20 @@ OS_EVENT    *LCDSem;
 //increments the current parameter
 static void handle_button0_interrupts(void* context, alt_u32 id)
 {
-    alt_up_av_config_dev * audio_config_dev;
-    audio_config_dev = alt_up_av_config_open_dev("/dev/audio_and_video_config_0");
-    int* params = (int *) context;
+    vm_params* settings = (vm_params *) context;
+    int params[VM_PARAMS_COUNT];
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON0_BASE, 0);
 
+    //edit a private copy and publish it whole; the button ISRs are the only
+    //writers and never preempt one another, so the snapshot never retries
+    vm_params_snapshot(settings, params);
+
     switch(params[0])
     {
         case 1: // increase volume
             if(params[1] < MAX_VOLUME)
             {
                 params[1] += VOLUME_SHIFT;
-                //write to the audio codec register to change volume
-                alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x2, (params[1]+0x180));
             }
             break;
         case 2: // increase echo delay
@@ -98,11 +122,12 @@ static void handle_button0_interrupts(void* context, alt_u32 id)
                 params[2] = params[2] - ECHO_DELAY_SHIFT;
             }
             break;
-        case 3: // turn on echo decay if not already on
-            if (params[3] == 0)
+        case 3: // lengthen the echo decay
+            if (params[3] < MAX_ECHO_DECAY)
             {
-                params[3] = 1;
+                params[3] += ECHO_DECAY_SHIFT;
             }
+            break;
         case 4: // increase frequency shift
             switch(params[4])
             {
@@ -132,25 +157,27 @@ static void handle_button0_interrupts(void* context, alt_u32 id)
             }
 
     }
+    vm_params_publish(settings, params);
     OSSemPost(LCDSem);
 }
 
 //decrements current parameter
 static void handle_button1_interrupts(void* context, alt_u32 id)
 {
-    alt_up_av_config_dev * audio_config_dev;
-    audio_config_dev = alt_up_av_config_open_dev("/dev/audio_and_video_config_0");
-    int* params = (int *) context;
+    vm_params* settings = (vm_params *) context;
+    int params[VM_PARAMS_COUNT];
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON1_BASE, 0);
 
+    //edit a private copy and publish it whole; the button ISRs are the only
+    //writers and never preempt one another, so the snapshot never retries
+    vm_params_snapshot(settings, params);
+
     switch(params[0])
     {
         case 1: // decrease volume
             if(params[1] > MIN_VOLUME)
             {
                 params[1] -= VOLUME_SHIFT;
-                //write to audio codec register to change volume
-                alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x2, (params[1]+0x180));
             }
             break;
         case 2: // decrease echo delay
@@ -159,11 +186,12 @@ static void handle_button1_interrupts(void* context, alt_u32 id)
                 params[2] = params[2] + ECHO_DELAY_SHIFT;
             }
             break;
-        case 3: // turn off echo decay if not already off
-            if (params[3] == 1)
+        case 3: // shorten the echo decay
+            if (params[3] > 0)
             {
-                params[3] = 0;
+                params[3] -= ECHO_DECAY_SHIFT;
             }
+            break;
         case 4: // decrease frequency shift
             switch(params[4])
             {
@@ -192,14 +220,17 @@ static void handle_button1_interrupts(void* context, alt_u32 id)
                     break;
             }
     }
+    vm_params_publish(settings, params);
     OSSemPost(LCDSem);
 }
 
 //changes tracked parameter to next parameter
 static void handle_button2_interrupts(void* context, alt_u32 id)
 {
-    int* params = (int *) context;
+    vm_params* settings = (vm_params *) context;
+    int params[VM_PARAMS_COUNT];
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON2_BASE, 0);
+    vm_params_snapshot(settings, params);
     if(params[0] == NUM_BUTTONS)
     {
         params[0] = 1;
@@ -208,14 +239,17 @@ static void handle_button2_interrupts(void* context, alt_u32 id)
     {
         params[0]++;
     }
+    vm_params_publish(settings, params);
     OSSemPost(LCDSem);
 }
 
 //changes tracked parameter to previous parameter
 static void handle_button3_interrupts(void* context, alt_u32 id)
 {
-    int* params = (int *) context;
+    vm_params* settings = (vm_params *) context;
+    int params[VM_PARAMS_COUNT];
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON3_BASE, 0);
+    vm_params_snapshot(settings, params);
     if(params[0] == 1)
         {
             params[0] = NUM_BUTTONS;
@@ -224,17 +258,99 @@ static void handle_button3_interrupts(void* context, alt_u32 id)
         {
             params[0]--;
         }
+        vm_params_publish(settings, params);
         OSSemPost(LCDSem);
 }
 
+//wakes audio_data_task once the codec input FIFO passes the audio core's read threshold
+static void handle_audio_interrupts(void* context, alt_u32 id)
+{
+    alt_up_audio_dev * audio_dev = (alt_up_audio_dev *) context;
+
+    //stays masked until the task has drained the FIFO, or it would fire again at once
+    alt_up_audio_disable_read_interrupt(audio_dev);
+    OSSemPost(AudioSem);
+}
+
+
+
+
+
+
+
+
+
+
+
+/*************************************************************************
+* STATISTICS                                                             *
+**************************************************************************/
+
+//prints a snapshot of the audio path statistics; times are in timestamp timer ticks
+static void report_audio_stats(void)
+{
+    static const char* names[] = {"decimate", "process", "output"};
+    vm_stats_counters c;
+    int s;
+
+    //BT_task outranks audio_data_task, so it cannot wait out an update it interrupted;
+    //skip this report and take the next one instead
+    if (vm_stats_snapshot(&audio_stats, &c) != 0 || c.blocks == 0)
+    {
+        return;
+    }
+
+    printf("audio: %lu blocks, latency min %u avg %u p99 %u max %u jitter %u, %u ticks/s\n",
+           c.blocks, c.min_latency, (unsigned int) (c.total_latency / c.blocks),
+           vm_stats_percentile(&c, 0.99), c.max_latency, c.max_latency - c.min_latency,
+           (unsigned int) alt_timestamp_freq());
+    for (s = AUDIO_STAGE_DECIMATE; s <= AUDIO_STAGE_OUTPUT; s++)
+    {
+        if (c.stages[s].runs > 0)
+        {
+            printf("  %-8s avg %u max %u\n", names[s],
+                   (unsigned int) (c.stages[s].total_ticks / c.stages[s].runs), c.stages[s].max_ticks);
+        }
+    }
+    printf("  overruns %lu underruns %lu stale pcm samples %lu\n",
+           c.overruns, c.underruns, c.stale_samples);
+}
+
+
+
+
+
 
 
 
 
 
+//converts the params[1] volume into the Q15 gain of the speaker output; the codec
+//stays at MAX_VOLUME and each VOLUME_SHIFT below it takes 3dB off digitally
+static int volume_gain(int volume)
+{
+    int gain = VM_RAMP_UNITY;
+    int level;
 
+    for (level = MAX_VOLUME; level > volume; level -= VOLUME_SHIFT)
+    {
+        gain = (gain * VOLUME_STEP_GAIN) >> 15;
+    }
+    return gain;
+}
 
+//the PCM link carries 16-bit two's complement samples as they are and pcm_interface.vhd
+//sign-extends them on the way back; the engine output is already signed, so an offset
+//here would wrap every loud sample
+static unsigned int pcm_from_sample(short sample)
+{
+    return (unsigned short) sample;
+}
 
+static short sample_from_pcm(unsigned int word)
+{
+    return (short) word;
+}
 
 
 /*************************************************************************
@@ -248,7 +364,8 @@ void LCD_task(void* pdata)
     //variable declaration and initialization
     INT8U err;
     FILE* lcd;
-    int * params = pdata;
+    vm_params* settings = (vm_params*) pdata;
+    int params[VM_PARAMS_COUNT];
     int freq_value = 0;
     int echo_delay_value = 0;
 
@@ -267,6 +384,7 @@ void LCD_task(void* pdata)
     while(1)
     {
         OSSemPend(LCDSem, 0, &err);
+        vm_params_snapshot(settings, params);
 
         //find which parameter is currently being modified and display user-friendly current value
         switch(params[0])
@@ -303,15 +421,8 @@ void LCD_task(void* pdata)
                 break;
 
             case 3:
-                fprintf(lcd, "Echo Reduction:\n");
-                if (params[3] == 0)
-                {
-                    fprintf(lcd, "Off\n");
-                }
-                else
-                {
-                    fprintf(lcd, "On\n");
-                }
+                fprintf(lcd, "Echo Decay:\n");
+                fprintf(lcd, "%d%%\n", params[3] * 100 / 32768);
                 break;
 
             case 4:
@@ -350,6 +461,7 @@ void BT_task(void* pdata)
     //variable declaration and initialization
     FILE* lm20;
     char input = '\0';
+    int loops = 0;
 
     lm20 = fopen (LM20_UART_NAME, "r+");
     if (lm20 == NULL)
@@ -377,6 +489,12 @@ void BT_task(void* pdata)
             printf("%c", input);
         } while (input != EOF);
 
+        if (++loops == AUDIO_STATS_PERIOD)
+        {
+            report_audio_stats();
+            loops = 0;
+        }
+
         OSTimeDlyHMSM(0, 0, 0, 100);
     }
 }
@@ -386,28 +504,48 @@ void BT_task(void* pdata)
 void audio_data_task(void* pdata)
 {
     //variable declaration and initialization
-    int * params = (int*) pdata;
+    vm_params* settings = (vm_params*) pdata;
+    int params[VM_PARAMS_COUNT];
+    unsigned int params_version;
     alt_up_audio_dev * audio_dev;
     alt_up_av_config_dev * audio_config_dev;
+    vm_engine engine;
+    vm_limiter limiter;
+    vm_ramp volume;
+    vm_resampler mic_down;
+    vm_resampler speaker_up;
+    vm_resampler phone_up;
 
     int i = 0;
-    int writeSize = 0;
-    int temp_value = 0;
+    int readSize = 0;
+    int frames = 0;
+    INT8U err;
     unsigned int audio_buf[AUDIO_BUFFER_SIZE];
-    unsigned int out_buf[4];
-    unsigned int echo_buf[ECHO_BUFFER_SIZE];
+    unsigned int out_buf[AUDIO_BUFFER_SIZE];
+    short block[AUDIO_BUFFER_SIZE / AUDIO_DECIMATION];
+    short phone_block[AUDIO_BUFFER_SIZE / AUDIO_DECIMATION];
+    short wide[AUDIO_BUFFER_SIZE];
+    short pcm_value = 0;
+    unsigned int start, mark, now;
     for (i = 0; i < AUDIO_BUFFER_SIZE ; i++)
     {
         audio_buf[i] = 0;
-    }
-    for (i = 0; i < 4; i++)
-    {
         out_buf[i] = 0;
     }
-    for (i = 0; i < ECHO_BUFFER_SIZE ; i++)
-    {
-        echo_buf[i] = 0;
-    }
+    vm_engine_init(&engine);
+    vm_engine_set_echo_storage(&engine, echo_ring, ECHO_RING_SIZE);
+    params_version = vm_params_snapshot(settings, params);
+    vm_engine_set_params(&engine, params);
+    //loud input plus echo is turned down smoothly rather than clipped
+    vm_limiter_init(&limiter, VM_LIMITER_THRESHOLD, VM_LIMITER_RELEASE);
+    vm_engine_set_limiter(&engine, &limiter);
+    vm_ramp_init(&volume, volume_gain(params[1]));
+    vm_resampler_init(&mic_down, AUDIO_DECIMATION);
+    vm_resampler_init(&speaker_up, AUDIO_DECIMATION);
+    vm_resampler_init(&phone_up, AUDIO_DECIMATION);
+    vm_stats_init(&audio_stats);
+    if (alt_timestamp_start() < 0)
+        printf("Error: no timestamp timer, audio statistics will read zero \n");
 
     //open devices
     audio_dev = alt_up_audio_open_dev ("/dev/audio_0");
@@ -428,113 +566,125 @@ void audio_data_task(void* pdata)
 
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x0, 0x17);
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x1, 0x17);
-    alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x2, 0x79);
+    alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x2, MAX_VOLUME + 0x180);
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x3, 0x79);
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x4, 0x15);
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x5, 0x06);
     alt_up_av_config_write_audio_cfg_register(audio_config_dev, 0x6, 0x00);
 
-    //initialize FIFOs coming in and out of DSP
-    altera_avalon_fifo_init(CURRENT_AUDIO_IN_IN_CSR_BASE, 0x0, 1, CURRENT_AUDIO_IN_IN_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(CURRENT_AUDIO_OUT_IN_CSR_BASE, 0x0, 1, CURRENT_AUDIO_OUT_OUT_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(SINE_IN_IN_CSR_BASE, 0x0, 1, SINE_IN_IN_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(COSINE_IN_IN_CSR_BASE, 0x0, 1, COSINE_IN_IN_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(ECHO_IN_IN_CSR_BASE, 0x0, 1, ECHO_IN_IN_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(ECHO_DELAY_IN_IN_CSR_BASE, 0x0, 1, ECHO_DELAY_IN_IN_FIFO_DEPTH-1);
-    altera_avalon_fifo_init(ECHO_OUT_IN_CSR_BASE, 0x0, 1, ECHO_OUT_OUT_FIFO_DEPTH-1);
+    //initialize FIFOs to and from the PCM interface; frequency shift and echo now run in vm_engine
     altera_avalon_fifo_init(PCM_IN_IN_CSR_BASE, 0x0, 1, PCM_IN_IN_FIFO_DEPTH-1);
     altera_avalon_fifo_init(PCM_OUT_IN_CSR_BASE, 0x0, 1, PCM_OUT_OUT_FIFO_DEPTH-1);
 
-    int sin_index = 0;
-    int cos_index = 80;
-    int echo_writeIndex = 0;
-    int echo_readIndex = 0;
+    //sleep between batches instead of polling the codec
+    AudioSem = OSSemCreate(0);
+    alt_irq_register(AUDIO_0_IRQ, audio_dev, handle_audio_interrupts);
+    alt_up_audio_enable_read_interrupt(audio_dev);
 
     while(1)
     {
-            //read the data from the left buffer
-            writeSize = alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_LEFT);
-            if (writeSize >= 3)
-            {
-                alt_up_audio_read_fifo(audio_dev, audio_buf, 4,  ALT_UP_AUDIO_LEFT);
+            //wait for the read interrupt; the timeout only covers a lost interrupt
+            OSSemPend(AudioSem, AUDIO_WAIT_TICKS, &err);
 
-                //send values to the frequency shifter
-                altera_avalon_fifo_write_fifo(CURRENT_AUDIO_IN_IN_BASE, CURRENT_AUDIO_IN_IN_CSR_BASE, audio_buf[0]);
-                altera_avalon_fifo_write_fifo(SINE_IN_IN_BASE, SINE_IN_IN_CSR_BASE, sine_samples[sin_index]);
-                altera_avalon_fifo_write_fifo(COSINE_IN_IN_BASE, COSINE_IN_IN_CSR_BASE, sine_samples[cos_index]);
+            //drain the left buffer a block at a time, in whole groups of AUDIO_DECIMATION samples
+            while ((readSize = alt_up_audio_read_fifo_avail(audio_dev, ALT_UP_AUDIO_LEFT)) >= AUDIO_MIN_READ)
+            {
+                vm_stats_write_begin(&audio_stats);
+                start = (unsigned int) alt_timestamp();
 
-                //update sinusoid index values
-                sin_index = (sin_index + params[4]);
-                if (sin_index >= NUM_SINE_SAMPLES)
+                //a full FIFO means the codec had nowhere to put its samples
+                if (readSize >= AUDIO_FIFO_DEPTH)
                 {
-                    sin_index = sin_index - NUM_SINE_SAMPLES;
+                    audio_stats.counters.overruns++;
                 }
-                cos_index = (cos_index + params[5]);
-                if (cos_index >= NUM_SINE_SAMPLES)
+                if (readSize > AUDIO_BUFFER_SIZE)
                 {
-                    cos_index = cos_index - NUM_SINE_SAMPLES;
+                    readSize = AUDIO_BUFFER_SIZE;
                 }
+                readSize -= readSize % AUDIO_DECIMATION;
+                frames = readSize / AUDIO_DECIMATION;
+                alt_up_audio_read_fifo(audio_dev, audio_buf, readSize, ALT_UP_AUDIO_LEFT);
 
-                //read output of frequency shifter and copy it into the echo buffer
-                temp_value = altera_avalon_fifo_read_fifo(CURRENT_AUDIO_OUT_OUT_BASE, CURRENT_AUDIO_OUT_IN_CSR_BASE);
-
-                echo_buf[echo_writeIndex] = temp_value;
-
-                //update read and write indices for the echo buffer
-                echo_writeIndex++;
-                if(echo_writeIndex >= ECHO_BUFFER_SIZE)
+                //filter down to 8kHz and run the whole block through the DSP chain
+                for (i = 0; i < readSize; i++)
                 {
-                    echo_writeIndex = 0;
+                    wide[i] = (short) audio_buf[i];
                 }
-                echo_readIndex = echo_writeIndex + params[2];
-                if (echo_readIndex >= ECHO_BUFFER_SIZE)
-                {
-                    echo_readIndex = echo_readIndex - ECHO_BUFFER_SIZE;
-                }
-
-                //input current value and delayed value
-                altera_avalon_fifo_write_fifo(ECHO_IN_IN_BASE, ECHO_IN_IN_CSR_BASE, temp_value);
-                altera_avalon_fifo_write_fifo(ECHO_DELAY_IN_IN_BASE, ECHO_DELAY_IN_IN_CSR_BASE, echo_buf[echo_readIndex]);
+                vm_decimate(&mic_down, wide, block, readSize);
+                mark = (unsigned int) alt_timestamp();
+                vm_stats_stage(&audio_stats, AUDIO_STAGE_DECIMATE, mark - start);
 
-                //get output of echo generator
-                audio_buf[0] = altera_avalon_fifo_read_fifo(ECHO_OUT_OUT_BASE, ECHO_OUT_IN_CSR_BASE);
-
-                if (*(int*)SWITCH_BASE & 0x1) //up: mic to speakers; down: phone
+                //pick up changed settings once per block, every value from the same publish,
+                //and ramp to them rather than jump
+                if (vm_params_version(settings) != params_version)
                 {
-                    //audio_buf[0] = audio_buf[0];
-                    audio_buf[1] = audio_buf[0];
-                    audio_buf[2] = audio_buf[0];
-                    audio_buf[3] = audio_buf[0];
+                    params_version = vm_params_snapshot(settings, params);
+                    vm_engine_update_params(&engine, params);
+                    vm_ramp_set(&volume, volume_gain(params[1]), VM_RAMP_EXPONENTIAL, VOLUME_RAMP_SAMPLES);
                 }
-                else
+                vm_process_block(&engine, block, block, frames);
+                now = (unsigned int) alt_timestamp();
+                vm_stats_stage(&audio_stats, AUDIO_STAGE_PROCESS, now - mark);
+                mark = now;
+
+                //an empty output FIFO means the speakers have already run dry
+                if (alt_up_audio_write_fifo_space(audio_dev, ALT_UP_AUDIO_LEFT) >= AUDIO_FIFO_DEPTH)
                 {
-                    //write data to the PCM interface
-                    altera_avalon_fifo_write_fifo(PCM_IN_IN_BASE, PCM_IN_IN_CSR_BASE, audio_buf[0] + 0x7fff);
+                    audio_stats.counters.underruns++;
                 }
 
                 if (*(int*)SWITCH_BASE & 0x1) //up: mic to speakers; down: phone
                 {
+                    //filter back up to 32kHz at the speaker volume
+                    vm_ramp_apply(&volume, block, block, frames);
+                    vm_interpolate(&speaker_up, block, wide, frames);
+                    for (i = 0; i < readSize; i++)
+                    {
+                        audio_buf[i] = (unsigned int) wide[i];
+                    }
+
                     // write data to the L and R buffers; R buffer will receive a copy of L buffer data
-                    alt_up_audio_write_fifo (audio_dev, audio_buf, 4, ALT_UP_AUDIO_RIGHT);
-                    alt_up_audio_write_fifo (audio_dev, audio_buf, 4, ALT_UP_AUDIO_LEFT);
+                    alt_up_audio_write_fifo (audio_dev, audio_buf, readSize, ALT_UP_AUDIO_RIGHT);
+                    alt_up_audio_write_fifo (audio_dev, audio_buf, readSize, ALT_UP_AUDIO_LEFT);
                 }
                 else
                 {
-                    // output from phone to speakers
-                    if (altera_avalon_fifo_read_level(PCM_OUT_IN_CSR_BASE) > 0)
+                    for (i = 0; i < frames; i++)
                     {
-						// downsample by a factor of 4 for Bluetooth audio
-                        out_buf[0] = altera_avalon_fifo_read_fifo(PCM_OUT_OUT_BASE, PCM_OUT_IN_CSR_BASE) + 0x7fff;
-                        out_buf[1] = out_buf[0];
-                        out_buf[2] = out_buf[0];
-                        out_buf[3] = out_buf[0];
+                        //write data to the PCM interface
+                        altera_avalon_fifo_write_fifo(PCM_IN_IN_BASE, PCM_IN_IN_CSR_BASE, pcm_from_sample(block[i]));
+
+                        // output from phone to speakers; repeat the last sample if none is waiting
+                        if (altera_avalon_fifo_read_level(PCM_OUT_IN_CSR_BASE) > 0)
+                        {
+                            pcm_value = sample_from_pcm(altera_avalon_fifo_read_fifo(PCM_OUT_OUT_BASE, PCM_OUT_IN_CSR_BASE));
+                        }
+                        else
+                        {
+                            audio_stats.counters.stale_samples++;
+                        }
+                        phone_block[i] = pcm_value;
+                    }
+
+                    //filter the phone audio up to 32kHz at the speaker volume
+                    vm_ramp_apply(&volume, phone_block, phone_block, frames);
+                    vm_interpolate(&phone_up, phone_block, wide, frames);
+                    for (i = 0; i < readSize; i++)
+                    {
+                        out_buf[i] = (unsigned int) wide[i];
                     }
 
                     //write data to the L and R buffers; R buffer will receive a copy of L buffer data
-                    alt_up_audio_write_fifo (audio_dev, out_buf, 4, ALT_UP_AUDIO_RIGHT);
-                    alt_up_audio_write_fifo (audio_dev, out_buf, 4, ALT_UP_AUDIO_LEFT);
+                    alt_up_audio_write_fifo (audio_dev, out_buf, readSize, ALT_UP_AUDIO_RIGHT);
+                    alt_up_audio_write_fifo (audio_dev, out_buf, readSize, ALT_UP_AUDIO_LEFT);
                 }
+
+                now = (unsigned int) alt_timestamp();
+                vm_stats_stage(&audio_stats, AUDIO_STAGE_OUTPUT, now - mark);
+                vm_stats_latency(&audio_stats, now - start);
+                vm_stats_write_end(&audio_stats);
             }
+            alt_up_audio_enable_read_interrupt(audio_dev);
     }
 }
 
@@ -546,16 +696,17 @@ int main(void)
     // params: array used to pass software values between interrupts and tasks
     //   params[0] - holds the current parameters; 1 correponds to volume, 2 to echo delay, etc.
     //   params[1] - volume level
-    //                  -default volume is 109 (0 on display)
+    //                  -default volume is 109 (0 on display), 18dB (six VOLUME_SHIFT steps) below MAX_VOLUME
+    //                  -applied as a ramped digital gain on the speaker output
     //                  -changed in steps of 3, minimum 91 (-6 on display) to maximum 127 (6 on display)
     //   params[2] - echo delay
     //                  -default echo delay is 4095, which corresponds to 0 delay (0 on display)
     //                  -this value decrements in steps of 800, where each step is an addition 0.1s in delay
     //                  -minimum value is 95, which corresponds to 0.5s delay
-    //   params[3] - echo reduction
-    //                  -default echo reduction is 2, which corresponds to no attenuation (1 on display)
-    //                  -other option is 1, which corresponds to attenuation by a factor of 4 (0.25 on display)
-    //                  -these are the only two options; zero echo is achieved by setting echo delay to 0
+    //   params[3] - echo decay
+    //                  -Q15 gain fed back through the echo, so each repeat is this fraction of the last
+    //                  -default is 0, a single echo (0% on display)
+    //                  -changed in steps of 8192 (25%) up to 24576 (75%)
     //   params[4] - frequency shift
     //                  -default value is 0, which corresponds to 0 frequency shift (0 on display)
     //                  -takes on three more values for shifts above zero, and two more values for shifts below zero
@@ -564,33 +715,35 @@ int main(void)
     //                  -auxiliary parameter for frequency shift, representing the step size to traverse cosine wave samples
     //                  -will either equal params[4] or be the negative
     //
-    // Potential synchronization issues have been acknowledged. This array is not subject to race conditions
-    // as each parameter is only written by one function. Values are written only in the interrupt routines.
-    // Any other function that uses this array only reads the value.
-    int params[10] = {1,109,4095,1,0,0};
+    // The values live in a vm_params block. The interrupt routines are its only writers and publish
+    // every change whole, so params[4] and params[5] never disagree; the tasks read snapshots of it.
+    static const int initial_params[VM_PARAMS_COUNT] = {1,109,4095,0,0,0};
+    vm_params params;
+
+    vm_params_init(&params, initial_params);
 
     //initialize interrupts
     IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTON0_BASE, 0x1);
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON0_BASE, 0x0);
-    alt_irq_register( BUTTON0_IRQ, params, handle_button0_interrupts );
+    alt_irq_register( BUTTON0_IRQ, &params, handle_button0_interrupts );
 
     IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTON1_BASE, 0x1);
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON1_BASE, 0x0);
-    alt_irq_register( BUTTON1_IRQ, params, handle_button1_interrupts );
+    alt_irq_register( BUTTON1_IRQ, &params, handle_button1_interrupts );
 
     IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTON2_BASE, 0x1);
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON2_BASE, 0x0);
-    alt_irq_register( BUTTON2_IRQ, params, handle_button2_interrupts );
+    alt_irq_register( BUTTON2_IRQ, &params, handle_button2_interrupts );
 
     IOWR_ALTERA_AVALON_PIO_IRQ_MASK(BUTTON3_BASE, 0x1);
     IOWR_ALTERA_AVALON_PIO_EDGE_CAP(BUTTON3_BASE, 0x0);
-    alt_irq_register( BUTTON3_IRQ, params, handle_button3_interrupts );
+    alt_irq_register( BUTTON3_IRQ, &params, handle_button3_interrupts );
 
     //semaphore to block/unblock LCD task so it only updates when a change is made
     LCDSem = OSSemCreate(1);
 
     OSTaskCreateExt(audio_data_task,
-                  params,
+                  &params,
                   (void *)&audio_data_task_stk[AUDIO_DATA_TASK_STACKSIZE-1],
                   AUDIO_DATA_TASK_PRIORITY,
                   AUDIO_DATA_TASK_PRIORITY,
@@ -600,7 +753,7 @@ int main(void)
                   0);
 
     OSTaskCreateExt(LCD_task,
-                  params,
+                  &params,
                   (void *)&LCD_task_stk[LCD_TASK_STACKSIZE-1],
                   LCD_TASK_PRIORITY,
                   LCD_TASK_PRIORITY,
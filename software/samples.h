@@ -2,331 +2,10 @@
 #define SAMPLES_H_
 
 
-// sine wave table
-// represents a single period of a sine wave, peak amplitude 32768
-// the period is divided into 320 intervals
-const int sine_samples[320] = {
-    0,
-643,
-1286,
-1929,
-2571,
-3212,
-3851,
-4490,
-5126,
-5760,
-6393,
-7022,
-7650,
-8274,
-8895,
-9512,
-10126,
-10736,
-11342,
-11943,
-12540,
-13132,
-13719,
-14300,
-14876,
-15447,
-16011,
-16569,
-17121,
-17666,
-18205,
-18736,
-19261,
-19777,
-20286,
-20788,
-21281,
-21766,
-22243,
-22711,
-23170,
-23621,
-24062,
-24494,
-24917,
-25330,
-25733,
-26127,
-26510,
-26883,
-27246,
-27598,
-27939,
-28270,
-28590,
-28899,
-29197,
-29483,
-29758,
-30022,
-30274,
-30514,
-30743,
-30959,
-31164,
-31357,
-31538,
-31706,
-31863,
-32007,
-32138,
-32258,
-32365,
-32459,
-32541,
-32610,
-32667,
-32711,
-32743,
-32762,
-32767,
-32762,
-32743,
-32711,
-32667,
-32610,
-32541,
-32459,
-32365,
-32258,
-32138,
-32007,
-31863,
-31706,
-31538,
-31357,
-31164,
-30959,
-30743,
-30514,
-30274,
-30022,
-29758,
-29483,
-29197,
-28899,
-28590,
-28270,
-27939,
-27598,
-27246,
-26883,
-26510,
-26127,
-25733,
-25330,
-24917,
-24494,
-24062,
-23621,
-23170,
-22711,
-22243,
-21766,
-21281,
-20788,
-20286,
-19777,
-19261,
-18736,
-18205,
-17666,
-17121,
-16569,
-16011,
-15447,
-14876,
-14300,
-13719,
-13132,
-12540,
-11943,
-11342,
-10736,
-10126,
-9512,
-8895,
-8274,
-7650,
-7022,
-6393,
-5760,
-5126,
-4490,
-3851,
-3212,
-2571,
-1929,
-1286,
-643,
-0,
--643,
--1286,
--1929,
--2571,
--3212,
--3851,
--4490,
--5126,
--5760,
--6393,
--7022,
--7650,
--8274,
--8895,
--9512,
--10126,
--10736,
--11342,
--11943,
--12540,
--13132,
--13719,
--14300,
--14876,
--15447,
--16011,
--16569,
--17121,
--17666,
--18205,
--18736,
--19261,
--19777,
--20286,
--20788,
--21281,
--21766,
--22243,
--22711,
--23170,
--23621,
--24062,
--24494,
--24917,
--25330,
--25733,
--26127,
--26510,
--26883,
--27246,
--27598,
--27939,
--28270,
--28590,
--28899,
--29197,
--29483,
--29758,
--30022,
--30274,
--30514,
--30743,
--30959,
--31164,
--31357,
--31538,
--31706,
--31863,
--32007,
--32138,
--32258,
--32365,
--32459,
--32541,
--32610,
--32667,
--32711,
--32743,
--32762,
--32768,
--32762,
--32743,
--32711,
--32667,
--32610,
--32541,
--32459,
--32365,
--32258,
--32138,
--32007,
--31863,
--31706,
--31538,
--31357,
--31164,
--30959,
--30743,
--30514,
--30274,
--30022,
--29758,
--29483,
--29197,
--28899,
--28590,
--28270,
--27939,
--27598,
--27246,
--26883,
--26510,
--26127,
--25733,
--25330,
--24917,
--24494,
--24062,
--23621,
--23170,
--22711,
--22243,
--21766,
--21281,
--20788,
--20286,
--19777,
--19261,
--18736,
--18205,
--17666,
--17121,
--16569,
--16011,
--15447,
--14876,
--14300,
--13719,
--13132,
--12540,
--11943,
--11342,
--10736,
--10126,
--9512,
--8895,
--8274,
--7650,
--7022,
--6393,
--5760,
--5126,
--4490,
--3851,
--3212,
--2571,
--1929,
--1286,
--643
-};
-    
+// sine wave tables used in frequency shifting; generated by host/gentables.c
+//   sine_samples - a single period of a sine wave, peak amplitude 32768, divided into 320 intervals
+//   quarter_sine_samples - the first quarter period, used by the oscillator in vm_nco.c
+#include "vm_tables.h"
+
 
 #endif /*SAMPLES_H_*/
@@ -0,0 +1,176 @@
+/*************************************************************************
+* Description:                                                           *
+* Multi-channel block engine.  Produces the same output per channel as   *
+* vm_engine, scaled by the channel gain.  The Hilbert filter is          *
+* evaluated one tap at a time for a whole row of channels, which keeps   *
+* the inner loop unit-stride for the compiler's vectorizer.  The         *
+* oscillator lookups and echo ring reads, which cannot vectorize, are    *
+* gathered into rows first, so the mixer that follows is branch-free     *
+* and vectorizes across channels as well.                                *
+**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "vm_channels.h"
+#include "vm_sat.h"
+
+#define     ECHO_INDEX_MASK     (VM_ECHO_BUFFER_SIZE - 1)
+
+
+int vm_channels_init(vm_channel_bank* bank, int num_channels)
+{
+    int stride = (num_channels + VM_CHANNEL_LANES - 1) / VM_CHANNEL_LANES * VM_CHANNEL_LANES;
+    int c;
+
+    memset(bank, 0, sizeof(*bank));
+    if (num_channels <= 0)
+    {
+        return -1;
+    }
+    bank->num_channels = num_channels;
+    bank->stride = stride;
+
+    bank->hilbert_line = calloc((size_t) (VM_HILBERT_ORDER + VM_BLOCK_SIZE) * stride, sizeof(short));
+    bank->echo_buf = calloc((size_t) VM_ECHO_BUFFER_SIZE * stride, sizeof(short));
+    bank->phase = calloc(stride, sizeof(unsigned int));
+    bank->increment = calloc(stride, sizeof(int));
+    bank->echo_delay = calloc(stride, sizeof(int));
+    bank->echo_decay = calloc(stride, sizeof(int));
+    bank->gain = calloc(stride, sizeof(int));
+    bank->acc = calloc(2 * stride, sizeof(int));
+    bank->lookup = calloc(3 * stride, sizeof(short));
+    if (bank->hilbert_line == NULL || bank->echo_buf == NULL || bank->phase == NULL
+        || bank->increment == NULL || bank->echo_delay == NULL || bank->echo_decay == NULL
+        || bank->gain == NULL
+        || bank->acc == NULL || bank->lookup == NULL)
+    {
+        vm_channels_free(bank);
+        return -1;
+    }
+
+    for (c = 0; c < stride; c++)
+    {
+        bank->gain[c] = VM_GAIN_UNITY;
+    }
+    return 0;
+}
+
+void vm_channels_free(vm_channel_bank* bank)
+{
+    free(bank->hilbert_line);
+    free(bank->echo_buf);
+    free(bank->phase);
+    free(bank->increment);
+    free(bank->echo_delay);
+    free(bank->echo_decay);
+    free(bank->gain);
+    free(bank->acc);
+    free(bank->lookup);
+    memset(bank, 0, sizeof(*bank));
+}
+
+void vm_channels_set_params(vm_channel_bank* bank, int channel, const int* params)
+{
+    bank->echo_delay[channel] = vm_echo_delay_from_param(params[2]);
+    bank->echo_decay[channel] = vm_echo_decay_from_param(params[3]);
+    bank->increment[channel] = params[4] * VM_NCO_LEGACY_STEP;
+}
+
+void vm_channels_set_shift_hz(vm_channel_bank* bank, int channel, int hz, int sample_rate)
+{
+    bank->increment[channel] = -vm_nco_increment_from_hz(hz, sample_rate);
+}
+
+void vm_channels_set_gain(vm_channel_bank* bank, int channel, int gain)
+{
+    bank->gain[channel] = gain;
+}
+
+// runs the whole chain over at most VM_BLOCK_SIZE samples of every channel
+static void process_chunk(vm_channel_bank* bank, const short* in, short* out, int n)
+{
+    int channels = bank->num_channels;
+    int stride = bank->stride;
+    short* x = bank->hilbert_line + VM_HILBERT_ORDER * stride;
+    int* even = bank->acc;
+    int* odd = bank->acc + stride;
+    short* sin_row = bank->lookup;
+    short* cos_row = bank->lookup + stride;
+    short* ring_row = bank->lookup + 2 * stride;
+    const int* echo_delay = bank->echo_delay;
+    const int* echo_decay = bank->echo_decay;
+    const int* gain = bank->gain;
+    int write_index = bank->echo_write_index;
+    int t, k, c;
+
+    for (t = 0; t < n; t++)
+    {
+        memcpy(x + t * stride, in + t * channels, channels * sizeof(short));
+    }
+
+    for (t = 0; t < n; t++)
+    {
+        const short* row = x + t * stride;
+        const short* direct = row - VM_HILBERT_DELAY * stride;
+        short* echo_row = bank->echo_buf + write_index * stride;
+
+        //antisymmetric filter across all channels, one folded tap at a time, with
+        //alternate taps summed apart as in hilbert.c so that neither sum can overflow
+        memset(bank->acc, 0, 2 * stride * sizeof(int));
+        for (k = 0; k < VM_HILBERT_TAPS; k++)
+        {
+            const short* near = row - 2 * k * stride;
+            const short* far = row - (VM_HILBERT_ORDER - 2 * k) * stride;
+            int* acc = (k & 1) ? odd : even;
+            int h = vm_hilbert_coefs[k];
+            for (c = 0; c < stride; c++)
+            {
+                acc[c] += h * (near[c] - far[c]);
+            }
+        }
+
+        //the oscillator table lookup branches and the ring reads are 16-bit gathers,
+        //so both get a loop of their own
+        for (c = 0; c < channels; c++)
+        {
+            vm_nco_lookup(bank->phase[c], &sin_row[c], &cos_row[c]);
+            bank->phase[c] += (unsigned int) bank->increment[c];
+            ring_row[c] = bank->echo_buf[((write_index - echo_delay[c]) & ECHO_INDEX_MASK) * stride + c];
+        }
+
+        //mix, echo and apply the channel gain, with selects rather than branches so
+        //that the loop vectorizes. The ring holds the shifted signal plus the decayed
+        //echo; a zero delay echoes the sample being written, which carries no feedback
+        for (c = 0; c < channels; c++)
+        {
+            int hilbert_out = vm_sat16(vm_half_sum(even[c], odd[c]) >> 14);
+            int shifted = vm_sat16((hilbert_out * sin_row[c] + direct[c] * cos_row[c]) >> 15);
+            int ring = ring_row[c];
+            int decay = echo_decay[c];
+            int delayed = (echo_delay[c] > 0) ? ring : shifted;
+
+            decay = (echo_delay[c] > 0) ? decay : 0;
+            echo_row[c] = vm_sat16(shifted + ((decay * delayed) >> 15));
+            out[t * channels + c] = vm_sat16((vm_sat_add16(shifted, delayed) * gain[c]) >> 15);
+        }
+        write_index = (write_index + 1) & ECHO_INDEX_MASK;
+    }
+
+    //keep the newest rows as history for the next block
+    memmove(bank->hilbert_line, bank->hilbert_line + n * stride, VM_HILBERT_ORDER * stride * sizeof(short));
+    bank->echo_write_index = write_index;
+}
+
+void vm_channels_process(vm_channel_bank* bank, const short* in, short* out, int n)
+{
+    int channels = bank->num_channels;
+
+    while (n > 0)
+    {
+        int chunk = (n > VM_BLOCK_SIZE) ? VM_BLOCK_SIZE : n;
+        process_chunk(bank, in, out, chunk);
+        in += chunk * channels;
+        out += chunk * channels;
+        n -= chunk;
+    }
+}
@@ -0,0 +1,66 @@
+/*************************************************************************
+* Description:                                                           *
+* Multi-channel version of the block engine.  Each channel is an         *
+* independent voice stream with its own oscillator phase, echo ring,     *
+* Hilbert history and gain.  State is stored structure-of-arrays with    *
+* channels innermost, so the filter and mixer loops run across channels  *
+* and vectorize without intrinsics.                                      *
+*                                                                        *
+* Sample buffers passed to vm_channels_process are interleaved: sample   *
+* t of channel c is at index t * num_channels + c.                       *
+**************************************************************************/
+
+#ifndef VM_CHANNELS_H_
+#define VM_CHANNELS_H_
+
+#include "vm_engine.h"
+
+/* Channel rows are padded to a multiple of this so every row is vector aligned */
+#define     VM_CHANNEL_LANES        16
+
+/* Gains are Q15 with this value meaning unity */
+#define     VM_GAIN_UNITY           32768
+
+
+typedef struct
+{
+    int num_channels;
+    int stride;                 // num_channels rounded up to VM_CHANNEL_LANES
+
+    // [(VM_HILBERT_ORDER + VM_BLOCK_SIZE) * stride], sample-major
+    short* hilbert_line;
+    // [VM_ECHO_BUFFER_SIZE * stride], sample-major; all channels share the write index
+    short* echo_buf;
+    int echo_write_index;
+
+    // [stride] each
+    unsigned int* phase;        // oscillator phase, as in vm_nco
+    int* increment;
+    int* echo_delay;
+    int* echo_decay;            // Q15 feedback gain, as in vm_delay
+    int* gain;
+    int* acc;                   // scratch for the filter accumulators, two per channel
+    short* lookup;              // scratch for the sine, cosine and delayed ring sample of each channel
+} vm_channel_bank;
+
+
+// allocates state for num_channels streams with neutral parameters and unity gain
+// returns 0 on success, -1 if memory could not be allocated
+int vm_channels_init(vm_channel_bank* bank, int num_channels);
+
+void vm_channels_free(vm_channel_bank* bank);
+
+// loads parameters for one channel, using the same encoding as vm_engine_set_params
+void vm_channels_set_params(vm_channel_bank* bank, int channel, const int* params);
+
+// sets an arbitrary frequency shift for one channel; positive values shift up
+void vm_channels_set_shift_hz(vm_channel_bank* bank, int channel, int hz, int sample_rate);
+
+// sets the output gain of one channel, in Q15 (VM_GAIN_UNITY is unity)
+void vm_channels_set_gain(vm_channel_bank* bank, int channel, int gain);
+
+// processes n samples of every channel; in and out are interleaved and may be the same buffer
+void vm_channels_process(vm_channel_bank* bank, const short* in, short* out, int n);
+
+
+#endif /*VM_CHANNELS_H_*/
@@ -0,0 +1,288 @@
+/*************************************************************************
+* Description:                                                           *
+* Multi-tap delay line.  Each block is written into the ring first, so   *
+* a tap shorter than the block reads samples from the same block; the    *
+* block is split where needed so that no tap reads a slot that has       *
+* already been overwritten, and so that the feedback never needs a       *
+* sample of the block it is computing.  A moving tap counts at both its  *
+* old and its new delay until its crossfade is over.                     *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_delay.h"
+#include "vm_engine.h"
+#include "vm_sat.h"
+
+
+// adds gain * src to acc; the unit-stride loop vectorizes
+static void scale_add(int* acc, const short* src, int gain, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        acc[i] += (gain * src[i]) >> 15;
+    }
+}
+
+// w = sat(in + gain * src), the feedback term for one contiguous segment
+static void feed_back(short* w, const short* in, const short* src, int gain, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        w[i] = vm_sat16(in[i] + ((gain * src[i]) >> 15));
+    }
+}
+
+// copies the n samples at delay into dst, in at most two contiguous pieces
+static void read_delayed(const vm_delay_line* line, int delay, short* dst, int n)
+{
+    unsigned int mask = line->size - 1;
+    unsigned int start = (line->write_index - delay) & mask;
+    unsigned int first = line->size - start;
+
+    if (first > (unsigned int) n)
+    {
+        first = n;
+    }
+    memcpy(dst, line->buf + start, first * sizeof(short));
+    memcpy(dst + first, line->buf, (n - first) * sizeof(short));
+}
+
+// the n samples tap t reads while it moves: its new delay blended with the
+// old one, whose share falls linearly to nothing over the crossfade
+static void read_moving(const vm_delay_line* line, int t, short* dst, int n)
+{
+    const vm_delay_fade* fade = &line->fades[t];
+    short old[VM_BLOCK_SIZE];
+    int fading = (fade->left < n) ? fade->left : n;
+    int step = (1 << 30) / fade->length;
+    int weight = fade->left * step;     // Q30 share of the old delay
+    int i;
+
+    read_delayed(line, line->taps[t].delay, dst, n);
+    read_delayed(line, fade->from, old, fading);
+    for (i = 0; i < fading; i++)
+    {
+        weight -= step;
+        dst[i] = (short) (dst[i] + (((old[i] - dst[i]) * (weight >> 16)) >> 14));
+    }
+}
+
+// runs at most VM_BLOCK_SIZE samples, short enough that no tap wraps onto them
+static void process_chunk(vm_delay_line* line, const short* in, short* out, int n)
+{
+    unsigned int mask = line->size - 1;
+    unsigned int start = line->write_index & mask;
+    unsigned int first = line->size - start;
+    int acc[VM_BLOCK_SIZE];
+    short fed[VM_BLOCK_SIZE];
+    short moving[VM_BLOCK_SIZE];
+    const short* dry = in;
+    int i, t;
+
+    if (first > (unsigned int) n)
+    {
+        first = n;
+    }
+
+    //add the decayed echo to what goes into the ring; the chunk is no longer than
+    //the feedback delay, so everything it reads was written by earlier chunks
+    if (line->feedback != 0 && line->num_taps > 0 && line->fades[0].left > 0
+        && line->fades[0].from > 0 && line->taps[0].delay > 0)
+    {
+        read_moving(line, 0, moving, n);
+        feed_back(fed, in, moving, line->feedback, n);
+        in = fed;
+    }
+    else if (line->feedback != 0 && line->num_taps > 0 && line->taps[0].delay > 0)
+    {
+        unsigned int fb_start = (line->write_index - line->taps[0].delay) & mask;
+        unsigned int fb_first = line->size - fb_start;
+
+        if (fb_first > (unsigned int) n)
+        {
+            fb_first = n;
+        }
+        feed_back(fed, in, line->buf + fb_start, line->feedback, fb_first);
+        feed_back(fed + fb_first, in + fb_first, line->buf, line->feedback, n - fb_first);
+        in = fed;
+    }
+
+    //write the block in at most two contiguous pieces
+    memcpy(line->buf + start, in, first * sizeof(short));
+    memcpy(line->buf, in + first, (n - first) * sizeof(short));
+
+    //a single unity tap at unity dry gain, the engine's echo, is one saturating add
+    if (line->dry_gain == VM_DELAY_UNITY && line->num_taps == 1
+        && line->taps[0].gain == VM_DELAY_UNITY && line->fades[0].left == 0)
+    {
+        unsigned int tap_start = (line->write_index - line->taps[0].delay) & mask;
+        unsigned int tap_first = line->size - tap_start;
+
+        if (tap_first > (unsigned int) n)
+        {
+            tap_first = n;
+        }
+        vm_sat_add_block(dry, line->buf + tap_start, out, tap_first);
+        vm_sat_add_block(dry + tap_first, line->buf, out + tap_first, n - tap_first);
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+        {
+            acc[i] = (line->dry_gain * dry[i]) >> 15;
+        }
+        for (t = 0; t < line->num_taps; t++)
+        {
+            unsigned int tap_start = (line->write_index - line->taps[t].delay) & mask;
+            unsigned int tap_first = line->size - tap_start;
+            int gain = line->taps[t].gain;
+
+            if (line->fades[t].left > 0)
+            {
+                read_moving(line, t, moving, n);
+                scale_add(acc, moving, gain, n);
+                continue;
+            }
+            if (tap_first > (unsigned int) n)
+            {
+                tap_first = n;
+            }
+            scale_add(acc, line->buf + tap_start, gain, tap_first);
+            scale_add(acc + tap_first, line->buf, gain, n - tap_first);
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            out[i] = vm_sat16(acc[i]);
+        }
+    }
+    line->write_index += n;
+
+    for (t = 0; t < line->num_taps; t++)
+    {
+        if (line->fades[t].left > 0)
+        {
+            line->fades[t].left = (line->fades[t].left > n) ? line->fades[t].left - n : 0;
+        }
+    }
+}
+
+
+int vm_delay_init(vm_delay_line* line, short* storage, unsigned int size)
+{
+    if (size == 0 || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+    memset(line, 0, sizeof(*line));
+    memset(storage, 0, size * sizeof(short));
+    line->buf = storage;
+    line->size = size;
+    line->dry_gain = VM_DELAY_UNITY;
+    return 0;
+}
+
+int vm_delay_set_tap(vm_delay_line* line, int index, int delay, int gain)
+{
+    if (index < 0 || index >= VM_DELAY_MAX_TAPS || delay < 0 || (unsigned int) delay >= line->size)
+    {
+        return -1;
+    }
+    line->taps[index].delay = delay;
+    line->taps[index].gain = gain;
+    line->fades[index].left = 0;
+    if (line->num_taps <= index)
+    {
+        line->num_taps = index + 1;
+    }
+    return 0;
+}
+
+int vm_delay_move_tap(vm_delay_line* line, int index, int delay, int samples)
+{
+    vm_delay_fade* fade;
+
+    if (index < 0 || index >= line->num_taps || delay < 0 || (unsigned int) delay >= line->size)
+    {
+        return -1;
+    }
+    fade = &line->fades[index];
+    if (samples > 0 && delay != line->taps[index].delay)
+    {
+        fade->from = line->taps[index].delay;
+        fade->left = samples;
+        fade->length = samples;
+    }
+    else if (samples <= 0)
+    {
+        fade->left = 0;
+    }
+    line->taps[index].delay = delay;
+    return 0;
+}
+
+int vm_delay_set_num_taps(vm_delay_line* line, int num_taps)
+{
+    if (num_taps < 0 || num_taps > VM_DELAY_MAX_TAPS)
+    {
+        return -1;
+    }
+    line->num_taps = num_taps;
+    return 0;
+}
+
+void vm_delay_set_feedback(vm_delay_line* line, int gain)
+{
+    line->feedback = gain;
+}
+
+void vm_delay_process(vm_delay_line* line, const short* in, short* out, int n)
+{
+    int longest = 0;
+    int feedback_delay = 0;
+    int limit, t;
+
+    //a chunk may not be longer than the space between the write point and the oldest tap,
+    //counting the old delay of a moving tap too
+    for (t = 0; t < line->num_taps; t++)
+    {
+        if (line->taps[t].delay > longest)
+        {
+            longest = line->taps[t].delay;
+        }
+        if (line->fades[t].left > 0 && line->fades[t].from > longest)
+        {
+            longest = line->fades[t].from;
+        }
+    }
+    limit = (int) line->size - longest;
+    if (line->feedback != 0 && line->num_taps > 0)
+    {
+        feedback_delay = line->taps[0].delay;
+        if (line->fades[0].left > 0 && line->fades[0].from > 0 && line->fades[0].from < feedback_delay)
+        {
+            feedback_delay = line->fades[0].from;
+        }
+    }
+    if (feedback_delay > 0 && feedback_delay < limit)
+    {
+        limit = feedback_delay;
+    }
+    if (limit > VM_BLOCK_SIZE)
+    {
+        limit = VM_BLOCK_SIZE;
+    }
+
+    while (n > 0)
+    {
+        int chunk = (n > limit) ? limit : n;
+        process_chunk(line, in, out, chunk);
+        in += chunk;
+        out += chunk;
+        n -= chunk;
+    }
+}
@@ -0,0 +1,75 @@
+/*************************************************************************
+* Description:                                                           *
+* Multi-tap delay line for long echoes.  The ring size is a power of     *
+* two so indices are masked, and every tap reads its delayed samples as  *
+* at most two contiguous segments per block, so the cost of a block      *
+* does not depend on how long the delays are.  Storage is supplied by    *
+* the caller: external SRAM on the board, heap memory on the host.       *
+*                                                                        *
+* With feedback the ring holds w[n] = x[n] + feedback * w[n - D0], D0    *
+* being the delay of tap 0, so every echo repeats at D0 intervals and    *
+* decays by the feedback gain each time.                                 *
+*                                                                        *
+* vm_delay_move_tap changes a delay without a click: for a while the     *
+* tap reads both the old and the new position and crossfades from one    *
+* to the other.  Taps that are not moving take the plain path.           *
+**************************************************************************/
+
+#ifndef VM_DELAY_H_
+#define VM_DELAY_H_
+
+#define     VM_DELAY_MAX_TAPS       4
+#define     VM_DELAY_UNITY          32768
+
+
+typedef struct
+{
+    int delay;          // in samples; 0 repeats the current sample
+    int gain;           // Q15, 32768 is unity
+} vm_delay_tap;
+
+// a tap moving from an old delay to its new one
+typedef struct
+{
+    int from;           // the old delay
+    int left;           // samples of crossfade still to go; 0 once settled
+    int length;
+} vm_delay_fade;
+
+typedef struct
+{
+    short* buf;
+    unsigned int size;
+    unsigned int write_index;
+    int dry_gain;       // Q15 gain of the undelayed signal
+    int feedback;       // Q15 gain fed back through tap 0; below unity to decay
+    int num_taps;
+    vm_delay_tap taps[VM_DELAY_MAX_TAPS];
+    vm_delay_fade fades[VM_DELAY_MAX_TAPS];
+} vm_delay_line;
+
+
+// attaches a ring of size samples (a power of two) and clears it; starts with
+// unity dry gain, no taps and no feedback. Returns 0 on success, -1 if size is not a power of two
+int vm_delay_init(vm_delay_line* line, short* storage, unsigned int size);
+
+// sets tap index (0 to VM_DELAY_MAX_TAPS-1) at once and grows the tap count to include it;
+// returns 0 on success, -1 if the delay does not fit in the ring
+int vm_delay_set_tap(vm_delay_line* line, int index, int delay, int gain);
+
+// moves an active tap to a new delay, crossfading over samples; a move during a
+// crossfade starts over from the delay being faded to. Returns 0 on success, -1
+// if index is not an active tap or the delay does not fit in the ring
+int vm_delay_move_tap(vm_delay_line* line, int index, int delay, int samples);
+
+// sets how many taps are active; returns 0, or -1 if num_taps is above VM_DELAY_MAX_TAPS
+int vm_delay_set_num_taps(vm_delay_line* line, int num_taps);
+
+// sets the feedback gain through tap 0; 0 gives plain feed-forward echoes
+void vm_delay_set_feedback(vm_delay_line* line, int gain);
+
+// out = dry_gain * in + sum of gain * delayed input; in and out may be the same buffer
+void vm_delay_process(vm_delay_line* line, const short* in, short* out, int n);
+
+
+#endif /*VM_DELAY_H_*/
@@ -0,0 +1,178 @@
+/*************************************************************************
+* Description:                                                           *
+* Block-based implementation of the Voice Manipulator DSP chain.         *
+* The frequency shifter follows freq_shifter.vhd and the echo follows    *
+* echo_core and the echo buffer previously kept in audio_data_task.      *
+**************************************************************************/
+
+
+/*************************************************************************
+* DEFINES AND INCLUDES                                                   *
+**************************************************************************/
+#include <string.h>
+#include "vm_engine.h"
+#include "hilbert.h"
+#include "vm_sat.h"
+
+
+void vm_engine_init(vm_engine* engine)
+{
+    memset(engine, 0, sizeof(*engine));
+    vm_nco_init(&engine->osc);
+    vm_delay_init(&engine->echo, engine->echo_buf, VM_ECHO_BUFFER_SIZE);
+    vm_delay_set_tap(&engine->echo, 0, 0, VM_DELAY_UNITY);
+}
+
+int vm_engine_set_echo_storage(vm_engine* engine, short* storage, unsigned int size)
+{
+    vm_delay_line line;
+    int t;
+
+    if (storage == NULL)
+    {
+        storage = engine->echo_buf;
+        size = VM_ECHO_BUFFER_SIZE;
+    }
+    //refuse before anything is cleared if a tap would not fit in the new ring
+    for (t = 0; t < engine->echo.num_taps; t++)
+    {
+        if ((unsigned int) engine->echo.taps[t].delay >= size)
+        {
+            return -1;
+        }
+    }
+    if (vm_delay_init(&line, storage, size) != 0)
+    {
+        return -1;
+    }
+    line.dry_gain = engine->echo.dry_gain;
+    line.feedback = engine->echo.feedback;
+    for (t = 0; t < engine->echo.num_taps; t++)
+    {
+        vm_delay_set_tap(&line, t, engine->echo.taps[t].delay, engine->echo.taps[t].gain);
+    }
+    engine->echo = line;
+    return 0;
+}
+
+int vm_echo_delay_from_param(int param)
+{
+    int delay = VM_ECHO_BUFFER_SIZE - 1 - param;
+
+    if (delay < 0)
+    {
+        delay = 0;
+    }
+    else if (delay > VM_ECHO_BUFFER_SIZE - 1)
+    {
+        delay = VM_ECHO_BUFFER_SIZE - 1;
+    }
+    return delay;
+}
+
+int vm_echo_decay_from_param(int param)
+{
+    //unity or more would never die away
+    if (param < 0)
+    {
+        return 0;
+    }
+    if (param > VM_DELAY_UNITY - 1)
+    {
+        return VM_DELAY_UNITY - 1;
+    }
+    return param;
+}
+
+void vm_engine_set_params(vm_engine* engine, const int* params)
+{
+    vm_delay_set_tap(&engine->echo, 0, vm_echo_delay_from_param(params[2]), VM_DELAY_UNITY);
+    vm_delay_set_feedback(&engine->echo, vm_echo_decay_from_param(params[3]));
+    vm_nco_set_legacy_step(&engine->osc, params[4]);
+}
+
+void vm_engine_update_params(vm_engine* engine, const int* params)
+{
+    vm_delay_move_tap(&engine->echo, 0, vm_echo_delay_from_param(params[2]), VM_RAMP_SAMPLES);
+    vm_delay_set_feedback(&engine->echo, vm_echo_decay_from_param(params[3]));
+    vm_nco_glide(&engine->osc, params[4] * VM_NCO_LEGACY_STEP, VM_RAMP_SAMPLES);
+}
+
+void vm_engine_set_shift_hz(vm_engine* engine, int hz, int sample_rate)
+{
+    vm_nco_set_frequency(&engine->osc, -hz, sample_rate);
+}
+
+void vm_engine_set_fft_shifter(vm_engine* engine, vm_fft_shifter* fft)
+{
+    engine->fft = fft;
+}
+
+void vm_engine_set_limiter(vm_engine* engine, vm_limiter* limiter)
+{
+    engine->limiter = limiter;
+}
+
+// frequency shifts at most VM_BLOCK_SIZE samples
+static void shift_chunk(vm_engine* engine, const short* in, short* out, int n)
+{
+    short* x = engine->hilbert_line + VM_HILBERT_ORDER;
+    short hilbert_out[VM_BLOCK_SIZE];
+    short delayed_buf[VM_BLOCK_SIZE];
+    short sin_buf[VM_BLOCK_SIZE];
+    short cos_buf[VM_BLOCK_SIZE];
+    const short* delayed;
+    int i;
+
+    if (engine->fft != NULL)
+    {
+        vm_fft_shifter_block(engine->fft, in, hilbert_out, delayed_buf, n);
+        delayed = delayed_buf;
+    }
+    else
+    {
+        memcpy(x, in, n * sizeof(short));
+        hilbert_block(x, hilbert_out, n);
+        delayed = x - VM_HILBERT_DELAY;
+    }
+    vm_nco_block(&engine->osc, sin_buf, cos_buf, n);
+
+    //mix the Hilbert output and the delayed input with the quadrature sinusoids
+    for (i = 0; i < n; i++)
+    {
+        out[i] = vm_sat16((hilbert_out[i] * sin_buf[i] + delayed[i] * cos_buf[i]) >> 15);
+    }
+
+    //keep the newest samples as history for the next block
+    if (engine->fft == NULL)
+    {
+        memmove(engine->hilbert_line, engine->hilbert_line + n, VM_HILBERT_ORDER * sizeof(short));
+    }
+}
+
+void vm_shift_block(vm_engine* engine, const short* in, short* out, int n)
+{
+    while (n > 0)
+    {
+        int chunk = (n > VM_BLOCK_SIZE) ? VM_BLOCK_SIZE : n;
+        shift_chunk(engine, in, out, chunk);
+        in += chunk;
+        out += chunk;
+        n -= chunk;
+    }
+}
+
+void vm_echo_block(vm_engine* engine, const short* in, short* out, int n)
+{
+    vm_delay_process(&engine->echo, in, out, n);
+}
+
+void vm_process_block(vm_engine* engine, const short* in, short* out, int n)
+{
+    vm_shift_block(engine, in, out, n);
+    vm_echo_block(engine, out, out, n);
+    if (engine->limiter != NULL)
+    {
+        vm_limiter_process(engine->limiter, out, out, n);
+    }
+}
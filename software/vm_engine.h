@@ -0,0 +1,127 @@
+/*************************************************************************
+* Description:                                                           *
+* Block-based audio processing engine for the Voice Manipulator.         *
+* Runs the frequency shift and echo stages over a whole block of         *
+* samples per call.  Contains no board-specific code, so the same        *
+* engine runs in audio_data_task and in the host tools.                  *
+**************************************************************************/
+
+#ifndef VM_ENGINE_H_
+#define VM_ENGINE_H_
+
+#include "vm_delay.h"
+#include "vm_fft_shift.h"
+#include "vm_limiter.h"
+#include "vm_nco.h"
+#include "vm_tables.h"
+
+
+/*************************************************************************
+* DEFINES                                                                *
+**************************************************************************/
+
+/* Largest block handled in one pass; larger requests are split */
+#define     VM_BLOCK_SIZE           128
+
+/* Hilbert filter order; 102 mirrors freq_shifter.vhd.  Any order generated into
+   vm_tables.c (30, 62 or 102) can be selected at build time, e.g. -DVM_HILBERT_ORDER=30,
+   trading stopband edge sharpness for speed.  Every kernel sees the order as a
+   constant, so its tap loops unroll. */
+#ifndef VM_HILBERT_ORDER
+#define     VM_HILBERT_ORDER        102
+#endif
+#define     VM_HILBERT_TAPS         ((VM_HILBERT_ORDER + 2) / 4)
+#define     VM_HILBERT_DELAY        (VM_HILBERT_ORDER / 2)
+
+/* Built-in echo ring; must stay a power of two so indices can be masked.
+   vm_engine_set_echo_storage swaps in a longer ring. */
+#define     VM_ECHO_BUFFER_SIZE     4096
+
+/* Length of the crossfades and glides of vm_engine_update_params, 32ms at 8kHz */
+#define     VM_RAMP_SAMPLES         256
+
+
+/*************************************************************************
+* TYPES                                                                  *
+**************************************************************************/
+
+// state of one audio stream; all history needed between blocks lives here
+typedef struct
+{
+    // frequency shifter: last VM_HILBERT_ORDER inputs followed by the current block
+    short hilbert_line[VM_HILBERT_ORDER + VM_BLOCK_SIZE];
+    vm_nco osc;
+    vm_fft_shifter* fft;        // replaces the Hilbert FIR when set
+
+    // echo generator; tap 0 is the params[2] echo, further taps may be added
+    // with vm_delay_set_tap(&engine->echo, ...)
+    short echo_buf[VM_ECHO_BUFFER_SIZE];
+    vm_delay_line echo;
+
+    vm_limiter* limiter;        // output gain and peak limiter, after the echo, when set
+} vm_engine;
+
+
+// even taps h0, h2, ... of the selected Hilbert filter, in Q15
+#define     VM_HILBERT_COEFS_OF(order)  VM_HILBERT_PASTE(hilbert_coefs_, order)
+#define     VM_HILBERT_PASTE(a, b)      a##b
+#define     vm_hilbert_coefs            VM_HILBERT_COEFS_OF(VM_HILBERT_ORDER)
+
+// tap magnitude sums of its entries 0, 2, ... and 1, 3, ..., usable in #if
+#define     VM_HILBERT_L1_OF(order, half)   VM_HILBERT_PASTE3(VM_HILBERT_L1_, order, half)
+#define     VM_HILBERT_PASTE3(a, b, c)      a##b##c
+#define     VM_HILBERT_L1_EVEN              VM_HILBERT_L1_OF(VM_HILBERT_ORDER, _EVEN)
+#define     VM_HILBERT_L1_ODD               VM_HILBERT_L1_OF(VM_HILBERT_ORDER, _ODD)
+
+
+/*************************************************************************
+* FUNCTIONS                                                              *
+**************************************************************************/
+
+// clears all history and sets neutral parameters (no shift, no echo delay)
+void vm_engine_init(vm_engine* engine);
+
+// loads parameters using the same encoding as the params array in main.c
+//   params[2] - echo delay, 4095 (no delay) down to 95 (0.5s at 8kHz)
+//   params[3] - echo decay, the Q15 gain fed back through the echo
+//   params[4] - sine table step, converted to an oscillator frequency; params[5]
+//               only ever differs from it in sign, which the cosine ignores
+void vm_engine_set_params(vm_engine* engine, const int* params);
+
+// as vm_engine_set_params, but without clicks for settings changed while running:
+// the echo delay crossfades and the shift glides over VM_RAMP_SAMPLES samples
+void vm_engine_update_params(vm_engine* engine, const int* params);
+
+// sets an arbitrary frequency shift; positive values shift up
+void vm_engine_set_shift_hz(vm_engine* engine, int hz, int sample_rate);
+
+// moves the echo to a ring of size samples (a power of two), e.g. in external
+// SRAM, so that delays up to size - 1 are possible; the ring is cleared and the
+// taps and feedback are kept. NULL returns to echo_buf. Returns 0 on success, or -1
+// on a bad size or when a tap's delay does not fit, leaving the echo as it was
+int vm_engine_set_echo_storage(vm_engine* engine, short* storage, unsigned int size);
+
+// runs the frequency shifter's Hilbert filter through fft instead of the FIR,
+// e.g. for a much longer filter; NULL returns to the FIR. Outputs are delayed
+// by a further fft->block samples, and the FIR history is not kept meanwhile
+void vm_engine_set_fft_shifter(vm_engine* engine, vm_fft_shifter* fft);
+
+// runs the output through limiter, with its own gain, after the echo; NULL
+// removes it. Outputs are delayed by a further VM_LIMITER_LATENCY samples
+void vm_engine_set_limiter(vm_engine* engine, vm_limiter* limiter);
+
+// converts the params[2] echo setting into the age of the echoed sample
+int vm_echo_delay_from_param(int param);
+
+// converts the params[3] echo decay setting into a Q15 feedback gain below unity
+int vm_echo_decay_from_param(int param);
+
+// processes n samples from in to out; in and out may be the same buffer
+void vm_process_block(vm_engine* engine, const short* in, short* out, int n);
+
+// the two stages run by vm_process_block, for callers that run them separately
+void vm_shift_block(vm_engine* engine, const short* in, short* out, int n);
+void vm_echo_block(vm_engine* engine, const short* in, short* out, int n);
+
+
+#endif /*VM_ENGINE_H_*/
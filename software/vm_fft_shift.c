@@ -0,0 +1,246 @@
+/*************************************************************************
+* Description:                                                           *
+* Overlap-save Hilbert filter.  Each transform takes the last order      *
+* samples of history plus block new ones, multiplies their spectrum by   *
+* the filter's and transforms back; the first order outputs are          *
+* wrapped around and dropped, the remaining block are exact.             *
+**************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "vm_fft_shift.h"
+
+/* Kaiser window shape for designed filters, about 80dB of stopband */
+#define     FFT_KAISER_BETA         8.0
+
+/* math.h only has M_PI outside strict C99 */
+#define     FFT_PI                  3.14159265358979323846
+
+
+// zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+static short round_to_short(float value)
+{
+    if (value >= 32767.0f)
+    {
+        return 32767;
+    }
+    if (value <= -32768.0f)
+    {
+        return -32768;
+    }
+    return (short) ((value >= 0.0f) ? (int) (value + 0.5f) : -(int) (0.5f - value));
+}
+
+// in-place radix-2 transform; inverse uses the conjugate twiddles and is unscaled
+static void fft(vm_complex* x, const vm_complex* twiddles, int size, int inverse)
+{
+    int i, j, k, len;
+
+    for (i = 1, j = 0; i < size; i++)
+    {
+        int bit = size >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j)
+        {
+            vm_complex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    for (len = 2; len <= size; len <<= 1)
+    {
+        int half = len >> 1;
+        int step = size / len;
+        for (i = 0; i < size; i += len)
+        {
+            for (k = 0; k < half; k++)
+            {
+                vm_complex w = twiddles[k * step];
+                vm_complex* a = &x[i + k];
+                vm_complex* b = &x[i + k + half];
+                float re, im;
+
+                if (inverse)
+                {
+                    w.im = -w.im;
+                }
+                re = b->re * w.re - b->im * w.im;
+                im = b->re * w.im + b->im * w.re;
+                b->re = a->re - re;
+                b->im = a->im - im;
+                a->re += re;
+                a->im += im;
+            }
+        }
+    }
+}
+
+// the Hilbert tap at lag within the filter, from the table or designed
+static double hilbert_tap(int order, int lag, const short* coefs)
+{
+    int center = order / 2;
+    int distance = lag - center;
+    double ratio;
+
+    if (distance % 2 == 0)
+    {
+        return 0.0;
+    }
+    if (coefs != NULL)
+    {
+        //the table holds the even lags 0, 2, ... below the center; the other half is mirrored
+        return (lag < center) ? coefs[lag / 2] / 32768.0 : -coefs[(order - lag) / 2] / 32768.0;
+    }
+    ratio = 2.0 * lag / order - 1.0;
+    return 2.0 / (FFT_PI * distance) * bessel_i0(FFT_KAISER_BETA * sqrt(1.0 - ratio * ratio))
+           / bessel_i0(FFT_KAISER_BETA);
+}
+
+// transform cost per new sample, in butterflies plus spectrum products
+static double cost_per_sample(int order, int size)
+{
+    int log_size = 0;
+
+    while ((1 << log_size) < size)
+    {
+        log_size++;
+    }
+    return ((double) size * log_size + size) / (size - order);
+}
+
+
+int vm_fft_shifter_init(vm_fft_shifter* s, void* storage, int order, int size, const short* coefs)
+{
+    int k;
+
+    if (order <= 0 || order % 2 != 0 || (coefs != NULL && order % 4 != 2)
+        || size > VM_FFT_MAX_SIZE || size <= order || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    memset(storage, 0, VM_FFT_SHIFTER_STORAGE(size));
+    s->order = order;
+    s->size = size;
+    s->block = size - order;
+    s->fill = 0;
+    s->filter = (vm_complex*) storage;
+    s->work = s->filter + size;
+    s->twiddles = s->work + size;
+    s->frame = (short*) (s->twiddles + size / 2);
+
+    for (k = 0; k < size / 2; k++)
+    {
+        s->twiddles[k].re = (float) cos(2.0 * FFT_PI * k / size);
+        s->twiddles[k].im = (float) -sin(2.0 * FFT_PI * k / size);
+    }
+
+    //delta at the center gives the delayed input in the real part, h the Hilbert output in the imaginary
+    for (k = 0; k <= order; k++)
+    {
+        s->filter[k].re = (k == order / 2) ? 1.0f : 0.0f;
+        s->filter[k].im = (float) hilbert_tap(order, k, coefs);
+    }
+    fft(s->filter, s->twiddles, size, 0);
+    for (k = 0; k < size; k++)
+    {
+        s->filter[k].re /= size;
+        s->filter[k].im /= size;
+    }
+    return 0;
+}
+
+// filters the full frame into work
+static void run_transform(vm_fft_shifter* s)
+{
+    int k;
+
+    for (k = 0; k < s->size; k++)
+    {
+        s->work[k].re = s->frame[k];
+        s->work[k].im = 0.0f;
+    }
+    fft(s->work, s->twiddles, s->size, 0);
+    for (k = 0; k < s->size; k++)
+    {
+        vm_complex x = s->work[k];
+        vm_complex g = s->filter[k];
+        s->work[k].re = x.re * g.re - x.im * g.im;
+        s->work[k].im = x.re * g.im + x.im * g.re;
+    }
+    fft(s->work, s->twiddles, s->size, 1);
+
+    //keep the newest samples as history for the next frame
+    memmove(s->frame, s->frame + s->block, s->order * sizeof(short));
+}
+
+void vm_fft_shifter_block(vm_fft_shifter* s, const short* in, short* hilbert_out, short* delayed_out, int n)
+{
+    while (n > 0)
+    {
+        int chunk = s->block - s->fill;
+        const vm_complex* y = s->work + s->order + s->fill;
+        int i;
+
+        if (chunk > n)
+        {
+            chunk = n;
+        }
+
+        //outputs of the previous frame go out as the samples of this one come in
+        for (i = 0; i < chunk; i++)
+        {
+            hilbert_out[i] = round_to_short(y[i].im);
+            delayed_out[i] = round_to_short(y[i].re);
+        }
+        memcpy(s->frame + s->order + s->fill, in, chunk * sizeof(short));
+        s->fill += chunk;
+        if (s->fill == s->block)
+        {
+            run_transform(s);
+            s->fill = 0;
+        }
+
+        in += chunk;
+        hilbert_out += chunk;
+        delayed_out += chunk;
+        n -= chunk;
+    }
+}
+
+int vm_fft_shifter_best_size(int order, int max_size)
+{
+    int best = 0;
+    int size;
+
+    for (size = 2; size <= max_size && size <= VM_FFT_MAX_SIZE; size <<= 1)
+    {
+        if (size > order && (best == 0 || cost_per_sample(order, size) < cost_per_sample(order, best)))
+        {
+            best = size;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,65 @@
+/*************************************************************************
+* Description:                                                           *
+* Frequency-domain Hilbert filter for the frequency shifter, for orders  *
+* far beyond the 102 of freq_shifter.vhd.  Blocks of input are run       *
+* through an overlap-save FFT against the spectrum of delta + j*h, so    *
+* one inverse transform yields both the delayed input (real part) and    *
+* the Hilbert output (imaginary part) that the mixer needs.  The cost    *
+* per sample grows with log(fft size) instead of with the order.         *
+*                                                                        *
+* Each transform consumes size - order new samples, and the outputs      *
+* come out that many samples later than the FIR path's.  The whole       *
+* transform runs in the call that completes a block, so the cost comes   *
+* in bursts.  Uses floating point, so it is meant for hosts and cores    *
+* with an FPU; the engine only runs it once vm_engine_set_fft_shifter    *
+* has selected it.                                                       *
+**************************************************************************/
+
+#ifndef VM_FFT_SHIFT_H_
+#define VM_FFT_SHIFT_H_
+
+/* Largest transform; 16384 points leave room for orders into the thousands */
+#define     VM_FFT_MAX_SIZE         16384
+
+/* Bytes of storage a shifter with a size point transform needs */
+#define     VM_FFT_SHIFTER_STORAGE(size)    ((2 * (size) + (size) / 2) * sizeof(vm_complex) + (size) * sizeof(short))
+
+
+typedef struct
+{
+    float re;
+    float im;
+} vm_complex;
+
+// state of one stream's frequency-domain Hilbert filter; the arrays live in
+// storage handed to vm_fft_shifter_init
+typedef struct
+{
+    int order;
+    int size;                   // transform length, a power of two
+    int block;                  // new samples per transform, size - order
+    int fill;                   // samples of the current block received so far
+    vm_complex* filter;         // spectrum of delta + j*h, scaled by 1/size
+    vm_complex* twiddles;       // exp(-2*pi*i*k/size) for k below size/2
+    vm_complex* work;           // output of the last transform
+    short* frame;               // order samples of history, then the block being filled
+} vm_fft_shifter;
+
+
+// sets up a shifter of the given even order with a size point transform, size
+// being a power of two above order, in storage of VM_FFT_SHIFTER_STORAGE(size)
+// bytes. coefs are the even taps in the vm_tables.c format, e.g. hilbert_coefs_102,
+// or NULL to design a Kaiser windowed filter of any order.
+// Returns 0 on success, -1 on a bad order or size
+int vm_fft_shifter_init(vm_fft_shifter* s, void* storage, int order, int size, const short* coefs);
+
+// for n inputs writes the Hilbert output and the input delayed by order / 2,
+// both a further s->block samples late
+void vm_fft_shifter_block(vm_fft_shifter* s, const short* in, short* hilbert_out, short* delayed_out, int n);
+
+// the transform size with the lowest cost per sample for order, within max_size;
+// 0 if even max_size is not above order
+int vm_fft_shifter_best_size(int order, int max_size);
+
+
+#endif /*VM_FFT_SHIFT_H_*/
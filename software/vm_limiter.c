@@ -0,0 +1,111 @@
+/*************************************************************************
+* Description:                                                           *
+* Look-ahead limiter.  When a chunk completes, its peak fixes the gain   *
+* it allows, and the chunk received before it is put out with the gain   *
+* ramping from the last level to the lower of the two chunks' limits.    *
+* Both ends of that ramp are within the held chunk's limit, so no        *
+* sample goes over the threshold.  Gains are applied in Q12 so that      *
+* samples boosted by up to VM_LIMITER_MAX_GAIN still fit in 32 bits.     *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_limiter.h"
+#include "vm_sat.h"
+
+
+// runs once per completed chunk
+static void run_chunk(vm_limiter* limiter)
+{
+    int scaled[VM_LIMITER_CHUNK];
+    int gain_step = (limiter->gain - limiter->applied_gain) >> VM_LIMITER_CHUNK_BITS;
+    int peak = 0;
+    int limit, end, step, i;
+
+    //apply the gain, ramping to a changed one across the chunk, and find the peak
+    for (i = 0; i < VM_LIMITER_CHUNK; i++)
+    {
+        int gain = limiter->applied_gain + gain_step * (i + 1);
+        int magnitude;
+
+        scaled[i] = (limiter->incoming[i] * (gain >> 3)) >> 12;
+        magnitude = (scaled[i] < 0) ? -scaled[i] : scaled[i];
+        peak = (magnitude > peak) ? magnitude : peak;
+    }
+    limiter->applied_gain += gain_step << VM_LIMITER_CHUNK_BITS;
+    if (gain_step == 0)
+    {
+        limiter->applied_gain = limiter->gain;
+    }
+    limit = (peak > limiter->threshold) ? (int) ((long long) limiter->threshold * VM_LIMITER_UNITY / peak)
+                                        : VM_LIMITER_UNITY;
+
+    //recover towards unity, but never above what the held chunk or the one after it allows
+    end = limiter->level + (int) (((long long) (VM_LIMITER_UNITY - limiter->level) * limiter->release) >> 15);
+    end = (end < limiter->held_limit) ? end : limiter->held_limit;
+    end = (end < limit) ? end : limit;
+
+    //the floored step keeps every ramp gain at or below both ends
+    step = (end - limiter->level) >> VM_LIMITER_CHUNK_BITS;
+    for (i = 0; i < VM_LIMITER_CHUNK; i++)
+    {
+        int gain = limiter->level + step * (i + 1);
+        limiter->ready[i] = vm_sat16((limiter->held[i] * (gain >> 3)) >> 12);
+    }
+    limiter->level += step << VM_LIMITER_CHUNK_BITS;
+
+    memcpy(limiter->held, scaled, sizeof(scaled));
+    limiter->held_limit = limit;
+}
+
+
+void vm_limiter_init(vm_limiter* limiter, int threshold, int release_samples)
+{
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->gain = VM_LIMITER_UNITY;
+    limiter->applied_gain = VM_LIMITER_UNITY;
+    limiter->threshold = threshold;
+    limiter->release = (release_samples > VM_LIMITER_CHUNK)
+                       ? VM_LIMITER_UNITY * VM_LIMITER_CHUNK / release_samples : VM_LIMITER_UNITY;
+    limiter->level = VM_LIMITER_UNITY;
+    limiter->held_limit = VM_LIMITER_UNITY;
+}
+
+void vm_limiter_set_gain(vm_limiter* limiter, int gain)
+{
+    if (gain < 0)
+    {
+        gain = 0;
+    }
+    else if (gain > VM_LIMITER_MAX_GAIN)
+    {
+        gain = VM_LIMITER_MAX_GAIN;
+    }
+    limiter->gain = gain;
+}
+
+void vm_limiter_process(vm_limiter* limiter, const short* in, short* out, int n)
+{
+    while (n > 0)
+    {
+        int chunk = VM_LIMITER_CHUNK - limiter->fill;
+
+        if (chunk > n)
+        {
+            chunk = n;
+        }
+
+        //take the input first, in case out is the same buffer
+        memcpy(limiter->incoming + limiter->fill, in, chunk * sizeof(short));
+        memcpy(out, limiter->ready + limiter->fill, chunk * sizeof(short));
+        limiter->fill += chunk;
+        if (limiter->fill == VM_LIMITER_CHUNK)
+        {
+            run_chunk(limiter);
+            limiter->fill = 0;
+        }
+
+        in += chunk;
+        out += chunk;
+        n -= chunk;
+    }
+}
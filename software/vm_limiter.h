@@ -0,0 +1,56 @@
+/*************************************************************************
+* Description:                                                           *
+* Per-stream output level: a Q15 gain, which may boost, followed by a    *
+* look-ahead peak limiter, so a loud stream is turned down smoothly      *
+* instead of clipping.  Audio is handled in chunks of VM_LIMITER_CHUNK   *
+* samples.  The limiter knows the peak of the chunk after the one it is  *
+* putting out, and ramps its gain linearly across each chunk to a level  *
+* that neither chunk exceeds; afterwards it recovers towards unity at    *
+* the release rate.  Peaks, gains and ramps are worked out per chunk,    *
+* so the per-sample loops are plain array arithmetic.                    *
+*                                                                        *
+* The output is VM_LIMITER_LATENCY samples late.                         *
+**************************************************************************/
+
+#ifndef VM_LIMITER_H_
+#define VM_LIMITER_H_
+
+#define     VM_LIMITER_CHUNK        16      // look-ahead, 2ms at 8kHz; a power of two
+#define     VM_LIMITER_CHUNK_BITS   4
+#define     VM_LIMITER_LATENCY      (2 * VM_LIMITER_CHUNK)
+
+#define     VM_LIMITER_UNITY        32768
+#define     VM_LIMITER_MAX_GAIN     (8 * VM_LIMITER_UNITY)     // +18dB
+
+/* Default ceiling, -1dBFS, and recovery time, 100ms at 8kHz */
+#define     VM_LIMITER_THRESHOLD    29205
+#define     VM_LIMITER_RELEASE      800
+
+
+typedef struct
+{
+    int gain;           // Q15 gain in front of the limiter
+    int applied_gain;   // where the gain ramp ended; a new gain ramps in over one chunk
+    int threshold;      // largest output magnitude
+    int release;        // Q15 share of the way back to unity recovered per chunk
+    int level;          // limiter gain at the end of the last chunk put out, Q15
+    int held_limit;     // highest gain the held chunk allows, Q15
+    int fill;           // samples of the incoming chunk received so far
+    short incoming[VM_LIMITER_CHUNK];
+    int held[VM_LIMITER_CHUNK];     // the chunk being looked past, with the gain applied
+    short ready[VM_LIMITER_CHUNK];  // limited output, going out as incoming fills
+} vm_limiter;
+
+
+// starts at unity gain and silence, limiting to threshold and recovering towards
+// unity with a time constant of about release_samples samples
+void vm_limiter_init(vm_limiter* limiter, int threshold, int release_samples);
+
+// sets the gain in front of the limiter, Q15 up to VM_LIMITER_MAX_GAIN
+void vm_limiter_set_gain(vm_limiter* limiter, int gain);
+
+// scales and limits n samples, VM_LIMITER_LATENCY samples late; in and out may be the same buffer
+void vm_limiter_process(vm_limiter* limiter, const short* in, short* out, int n);
+
+
+#endif /*VM_LIMITER_H_*/
@@ -0,0 +1,129 @@
+/*************************************************************************
+* Description:                                                           *
+* Phase-accumulator oscillator.  The top two phase bits select the       *
+* quadrant, the next eight the quarter-table entry, and the following    *
+* sixteen the interpolation fraction.                                    *
+**************************************************************************/
+
+#include "vm_nco.h"
+#include "samples.h"
+
+#define     QUARTER_BITS        VM_QUARTER_SINE_BITS
+#define     QUARTER_SIZE        (1 << QUARTER_BITS)
+#define     FRACTION_BITS       16
+#define     INDEX_SHIFT         (30 - QUARTER_BITS)
+#define     FRACTION_SHIFT      (INDEX_SHIFT - FRACTION_BITS)
+#define     QUARTER_PHASE       0x40000000u
+
+
+// sine of a phase, interpolating between quarter-table entries
+static short sine_of(unsigned int phase)
+{
+    unsigned int quadrant = phase >> 30;
+    int index = (phase >> INDEX_SHIFT) & (QUARTER_SIZE - 1);
+    int fraction = (phase >> FRACTION_SHIFT) & ((1 << FRACTION_BITS) - 1);
+    int a, b, value;
+
+    //the second and fourth quadrants walk the table backwards
+    if (quadrant & 1)
+    {
+        a = quarter_sine_samples[QUARTER_SIZE - index];
+        b = quarter_sine_samples[QUARTER_SIZE - index - 1];
+    }
+    else
+    {
+        a = quarter_sine_samples[index];
+        b = quarter_sine_samples[index + 1];
+    }
+    value = a + (((b - a) * fraction) >> FRACTION_BITS);
+
+    return (short) ((quadrant & 2) ? -value : value);
+}
+
+
+void vm_nco_init(vm_nco* nco)
+{
+    nco->phase = 0;
+    nco->increment = 0;
+    nco->target = 0;
+    nco->glide_step = 0;
+    nco->glide_left = 0;
+}
+
+int vm_nco_increment_from_hz(int hz, int sample_rate)
+{
+    //half the sample rate or more would not fit a signed increment
+    int limit = (sample_rate - 1) / 2;
+
+    if (hz > limit)
+    {
+        hz = limit;
+    }
+    else if (hz < -limit)
+    {
+        hz = -limit;
+    }
+    return (int) ((long long) hz * 4294967296LL / sample_rate);
+}
+
+void vm_nco_set_frequency(vm_nco* nco, int hz, int sample_rate)
+{
+    nco->increment = vm_nco_increment_from_hz(hz, sample_rate);
+    nco->glide_left = 0;
+}
+
+void vm_nco_set_legacy_step(vm_nco* nco, int step)
+{
+    nco->increment = step * VM_NCO_LEGACY_STEP;
+    nco->glide_left = 0;
+}
+
+void vm_nco_glide(vm_nco* nco, int increment, int samples)
+{
+    if (samples <= 0)
+    {
+        nco->increment = increment;
+        nco->glide_left = 0;
+        return;
+    }
+    nco->target = increment;
+    nco->glide_step = (int) (((long long) increment - nco->increment) / samples);
+    nco->glide_left = samples;
+}
+
+void vm_nco_lookup(unsigned int phase, short* sin_out, short* cos_out)
+{
+    *sin_out = sine_of(phase);
+    *cos_out = sine_of(phase + QUARTER_PHASE);
+}
+
+void vm_nco_block(vm_nco* nco, short* sin_out, short* cos_out, int n)
+{
+    unsigned int phase = nco->phase;
+    int i = 0;
+
+    //a glide ends within the block, after which the increment is constant again
+    if (nco->glide_left > 0)
+    {
+        int gliding = (nco->glide_left < n) ? nco->glide_left : n;
+        unsigned int increment = (unsigned int) nco->increment;
+
+        for (; i < gliding; i++)
+        {
+            sin_out[i] = sine_of(phase);
+            cos_out[i] = sine_of(phase + QUARTER_PHASE);
+            increment += (unsigned int) nco->glide_step;
+            phase += increment;
+        }
+        nco->glide_left -= gliding;
+        nco->increment = (nco->glide_left == 0) ? nco->target : (int) increment;
+    }
+
+    for (; i < n; i++)
+    {
+        sin_out[i] = sine_of(phase);
+        cos_out[i] = sine_of(phase + QUARTER_PHASE);
+        phase += (unsigned int) nco->increment;
+    }
+    nco->phase = phase;
+}
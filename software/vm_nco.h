@@ -0,0 +1,52 @@
+/*************************************************************************
+* Description:                                                           *
+* Phase-accumulator oscillator for the frequency shifter.  A 32-bit      *
+* phase is looked up in a quarter-wave table with linear interpolation,  *
+* so any shift frequency can be produced instead of the six step sizes   *
+* of the 320-entry table.  Sine and cosine come from the same phase.     *
+* A frequency change can glide over a number of samples; the phase is    *
+* never reset, so the output stays continuous either way.                *
+**************************************************************************/
+
+#ifndef VM_NCO_H_
+#define VM_NCO_H_
+
+/* Phase increment that reproduces one step of the 320-entry sine_samples table */
+#define     VM_NCO_LEGACY_STEP      13421773    // 2^32 / 320
+
+
+typedef struct
+{
+    unsigned int phase;         // 2^32 is one full period
+    int increment;              // phase advance per sample; may be negative
+    int target;                 // increment a glide ends at
+    int glide_step;             // change of increment per sample while gliding
+    int glide_left;             // samples of glide still to go
+} vm_nco;
+
+
+// starts at phase 0 (sine 0, cosine at peak) with no frequency
+void vm_nco_init(vm_nco* nco);
+
+// phase increment of hz at sample_rate; |hz| is held below the Nyquist frequency
+int vm_nco_increment_from_hz(int hz, int sample_rate);
+
+// sets the oscillator frequency; positive hz shifts audio down, as the
+// positive table steps of the original design did
+void vm_nco_set_frequency(vm_nco* nco, int hz, int sample_rate);
+
+// sets the frequency from a sine_samples step size (params[4] in main.c)
+void vm_nco_set_legacy_step(vm_nco* nco, int step);
+
+// moves the increment linearly to increment over samples; set_frequency and
+// set_legacy_step jump at once and cancel a glide
+void vm_nco_glide(vm_nco* nco, int increment, int samples);
+
+// sine and cosine of a phase, in Q15
+void vm_nco_lookup(unsigned int phase, short* sin_out, short* cos_out);
+
+// writes the next n sine and cosine values and advances the phase
+void vm_nco_block(vm_nco* nco, short* sin_out, short* cos_out, int n);
+
+
+#endif /*VM_NCO_H_*/
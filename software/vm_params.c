@@ -0,0 +1,46 @@
+/*************************************************************************
+* Description:                                                           *
+* Settings block with a sequence-count snapshot.                         *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_params.h"
+
+// orders the sequence count against the values on both sides
+#define     VM_PARAMS_BARRIER()     __sync_synchronize()
+
+
+void vm_params_init(vm_params* params, const int* values)
+{
+    params->sequence = 0;
+    memcpy(params->values, values, sizeof(params->values));
+}
+
+void vm_params_publish(vm_params* params, const int* values)
+{
+    params->sequence++;
+    VM_PARAMS_BARRIER();
+    memcpy(params->values, values, sizeof(params->values));
+    VM_PARAMS_BARRIER();
+    params->sequence++;
+}
+
+unsigned int vm_params_snapshot(const vm_params* params, int* out)
+{
+    unsigned int before, after;
+
+    do
+    {
+        before = params->sequence;
+        VM_PARAMS_BARRIER();
+        memcpy(out, (const void*) params->values, sizeof(params->values));
+        VM_PARAMS_BARRIER();
+        after = params->sequence;
+    } while ((before & 1) != 0 || before != after);
+    return before;
+}
+
+unsigned int vm_params_version(const vm_params* params)
+{
+    return params->sequence & ~1u;
+}
@@ -0,0 +1,44 @@
+/*************************************************************************
+* Description:                                                           *
+* Versioned block of the user settings, using the params[] encoding of   *
+* main.c.  The control path edits a private copy and publishes all of    *
+* it at once; the audio path takes a snapshot once per block, so a       *
+* frequency shift step and its cosine twin, or any other group of        *
+* values, always change together.                                        *
+*                                                                        *
+* Publishing bumps a sequence count before and after the copy, and a     *
+* snapshot retries until it saw no publish in progress, as in            *
+* vm_stats.  There must be one writer at a time: one thread, or the      *
+* board's button ISRs, which never preempt one another.  Readers never   *
+* block the writer and never take a lock, so any number of streams can   *
+* follow the same block.                                                 *
+**************************************************************************/
+
+#ifndef VM_PARAMS_H_
+#define VM_PARAMS_H_
+
+#define     VM_PARAMS_COUNT     10
+
+
+typedef struct
+{
+    volatile unsigned int sequence;         // odd while a publish is in progress
+    int values[VM_PARAMS_COUNT];
+} vm_params;
+
+
+// sets the first version of the values
+void vm_params_init(vm_params* params, const int* values);
+
+// replaces every value at once; only one writer may publish at a time
+void vm_params_publish(vm_params* params, const int* values);
+
+// copies a consistent set of values into out and returns its version; safe from any thread
+unsigned int vm_params_snapshot(const vm_params* params, int* out);
+
+// the version a snapshot taken now would return, give or take a publish in
+// progress; a cheap test for whether anything changed
+unsigned int vm_params_version(const vm_params* params);
+
+
+#endif /*VM_PARAMS_H_*/
@@ -0,0 +1,138 @@
+/*************************************************************************
+* Description:                                                           *
+* Smoothed gain.  Exponential ramps compute where the gain will be at    *
+* the end of each segment of up to RAMP_MAX_SEGMENT samples, decay^n of  *
+* the way, and go there in a straight line; segments of 4ms at 8kHz are  *
+* inaudible.                                                             *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_ramp.h"
+
+#define     RAMP_MAX_SEGMENT    32      // longest straight segment of an exponential ramp
+#define     RAMP_SETTLED        (1 << VM_RAMP_FRACTION_BITS)    // within one Q15 step of the target
+
+
+// gains from start + step to start + n * step; never above unity, so no saturation
+static void apply_segment(const short* in, short* out, int n, int start, int step)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int gain = (start + step * (i + 1)) >> VM_RAMP_FRACTION_BITS;
+        out[i] = (short) ((in[i] * gain) >> 15);
+    }
+}
+
+// x^n in Q15
+static int power_q15(int x, int n)
+{
+    int result = VM_RAMP_UNITY;
+
+    while (n > 0)
+    {
+        if (n & 1)
+        {
+            result = (result * x) >> 15;
+        }
+        x = (x * x) >> 15;
+        n >>= 1;
+    }
+    return result;
+}
+
+
+void vm_ramp_init(vm_ramp* ramp, int gain)
+{
+    memset(ramp, 0, sizeof(*ramp));
+    vm_ramp_set(ramp, gain, VM_RAMP_NONE, 0);
+}
+
+void vm_ramp_set(vm_ramp* ramp, int gain, int shape, int samples)
+{
+    if (gain < 0)
+    {
+        gain = 0;
+    }
+    else if (gain > VM_RAMP_UNITY)
+    {
+        gain = VM_RAMP_UNITY;
+    }
+    ramp->target = gain << VM_RAMP_FRACTION_BITS;
+    ramp->shape = shape;
+    ramp->remaining = 0;
+
+    if (shape == VM_RAMP_NONE || samples <= 0 || ramp->target == ramp->value)
+    {
+        ramp->value = ramp->target;
+    }
+    else if (shape == VM_RAMP_LINEAR)
+    {
+        ramp->step = (ramp->target - ramp->value) / samples;
+        ramp->remaining = samples;
+    }
+    else
+    {
+        //1 - 1/samples per sample; clamped so it never rounds to unity
+        ramp->decay = VM_RAMP_UNITY - VM_RAMP_UNITY / samples;
+        if (ramp->decay > VM_RAMP_UNITY - 1)
+        {
+            ramp->decay = VM_RAMP_UNITY - 1;
+        }
+        ramp->remaining = 1;
+    }
+}
+
+void vm_ramp_apply(vm_ramp* ramp, const short* in, short* out, int n)
+{
+    int i;
+
+    while (n > 0 && ramp->remaining > 0)
+    {
+        int segment, end;
+
+        if (ramp->shape == VM_RAMP_LINEAR)
+        {
+            segment = (n < ramp->remaining) ? n : ramp->remaining;
+            ramp->remaining -= segment;
+            end = (ramp->remaining == 0) ? ramp->target : ramp->value + ramp->step * segment;
+        }
+        else
+        {
+            long long left;
+
+            segment = (n < RAMP_MAX_SEGMENT) ? n : RAMP_MAX_SEGMENT;
+            left = (long long) (ramp->value - ramp->target) * power_q15(ramp->decay, segment) >> 15;
+            if (left < RAMP_SETTLED && left > -RAMP_SETTLED)
+            {
+                left = 0;
+                ramp->remaining = 0;
+            }
+            end = ramp->target + (int) left;
+        }
+
+        apply_segment(in, out, segment, ramp->value, (end - ramp->value) / segment);
+        ramp->value = end;
+        in += segment;
+        out += segment;
+        n -= segment;
+    }
+
+    //settled: nothing to do at unity, a constant gain otherwise
+    if (n > 0 && ramp->value == (VM_RAMP_UNITY << VM_RAMP_FRACTION_BITS))
+    {
+        if (out != in)
+        {
+            memmove(out, in, n * sizeof(short));
+        }
+    }
+    else if (n > 0)
+    {
+        int gain = ramp->value >> VM_RAMP_FRACTION_BITS;
+        for (i = 0; i < n; i++)
+        {
+            out[i] = (short) ((in[i] * gain) >> 15);
+        }
+    }
+}
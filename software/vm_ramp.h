@@ -0,0 +1,48 @@
+/*************************************************************************
+* Description:                                                           *
+* Smoothed gain for click-free level changes.  A new gain is reached     *
+* either linearly over a fixed number of samples or exponentially, a     *
+* constant fraction of the remaining distance per sample, which sounds   *
+* even in dB.  Gains are applied in straight-line segments worked out    *
+* once per block, or per few ms for exponential ramps, so the per-sample *
+* loop has no branches and vectorizes; once the target is reached only a *
+* constant gain, or nothing at unity, is applied.                        *
+*                                                                        *
+* Gains are Q15 from 0 to unity, kept with VM_RAMP_FRACTION_BITS extra   *
+* bits so that slow ramps still move every sample.                       *
+**************************************************************************/
+
+#ifndef VM_RAMP_H_
+#define VM_RAMP_H_
+
+#define     VM_RAMP_NONE            0       // jump straight to the new gain
+#define     VM_RAMP_LINEAR          1
+#define     VM_RAMP_EXPONENTIAL     2
+
+#define     VM_RAMP_UNITY           32768
+#define     VM_RAMP_FRACTION_BITS   8
+
+
+typedef struct
+{
+    int value;          // current gain, Q15 << VM_RAMP_FRACTION_BITS
+    int target;         // same scale
+    int shape;
+    int step;           // linear: change per sample
+    int remaining;      // linear: samples left; exponential: nonzero until settled
+    int decay;          // exponential: Q15 fraction of the distance left after one sample
+} vm_ramp;
+
+
+// starts settled at gain (Q15, at most unity)
+void vm_ramp_init(vm_ramp* ramp, int gain);
+
+// heads for gain (Q15, clamped to 0 to unity) with shape; samples is the
+// length of a linear ramp, or the time constant of an exponential one
+void vm_ramp_set(vm_ramp* ramp, int gain, int shape, int samples);
+
+// out = in * gain for n samples while the gain moves on; in and out may be the same buffer
+void vm_ramp_apply(vm_ramp* ramp, const short* in, short* out, int n);
+
+
+#endif /*VM_RAMP_H_*/
@@ -0,0 +1,134 @@
+/*************************************************************************
+* Description:                                                           *
+* Polyphase resampler.  The decimator folds the symmetric lowpass over   *
+* mirrored pairs, halving its multiplies again.  The interpolator        *
+* splits the lowpass into factor branches of taps_per_phase taps, one    *
+* per output phase, and scales by the factor to make up for the zeros    *
+* that upsampling would have inserted.                                   *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_resample.h"
+#include "vm_sat.h"
+
+//the decimator sums half the taps times 17-bit pairs and each interpolator branch
+//some of them times samples, so either fits whenever the whole lowpass does on 16 bits
+#if !VM_SUM_FITS(VM_RESAMPLE_L1_2, 16) || !VM_SUM_FITS(VM_RESAMPLE_L1_3, 16) \
+    || !VM_SUM_FITS(VM_RESAMPLE_L1_4, 16) || !VM_SUM_FITS(VM_RESAMPLE_L1_6, 16)
+#error "a resampling lowpass can overflow a 32-bit sum"
+#endif
+
+
+int vm_resampler_init(vm_resampler* r, int factor)
+{
+    int p, i;
+
+    memset(r, 0, sizeof(*r));
+    switch (factor)
+    {
+        case 2:
+            r->coefs = resample_coefs_2;
+            break;
+        case 3:
+            r->coefs = resample_coefs_3;
+            break;
+        case 4:
+            r->coefs = resample_coefs_4;
+            break;
+        case 6:
+            r->coefs = resample_coefs_6;
+            break;
+        default:
+            return -1;
+    }
+    r->factor = factor;
+    r->length = factor * VM_RESAMPLE_TAPS_PER_PHASE;
+
+    for (p = 0; p < factor; p++)
+    {
+        for (i = 0; i < VM_RESAMPLE_TAPS_PER_PHASE; i++)
+        {
+            r->phase_coefs[p * VM_RESAMPLE_TAPS_PER_PHASE + i] = r->coefs[p + i * factor];
+        }
+    }
+    return 0;
+}
+
+// decimates at most VM_BLOCK_SIZE inputs
+static int decimate_chunk(vm_resampler* r, const short* in, short* out, int n)
+{
+    short* x = r->line + r->length;
+    int half = r->length / 2;
+    int count = 0;
+    int i, j;
+
+    memcpy(x, in, n * sizeof(short));
+
+    //only the kept outputs are computed
+    for (i = r->skip; i < n; i += r->factor)
+    {
+        const short* oldest = x + i - r->length + 1;
+        int acc = 0;
+        for (j = 0; j < half; j++)
+        {
+            acc += r->coefs[j] * (x[i - j] + oldest[j]);
+        }
+        out[count++] = vm_sat16(acc >> 15);
+    }
+    r->skip = i - n;
+
+    memmove(r->line, r->line + n, r->length * sizeof(short));
+    return count;
+}
+
+int vm_decimate(vm_resampler* r, const short* in, short* out, int n)
+{
+    int count = 0;
+
+    while (n > 0)
+    {
+        int chunk = (n > VM_BLOCK_SIZE) ? VM_BLOCK_SIZE : n;
+        count += decimate_chunk(r, in, out + count, chunk);
+        in += chunk;
+        n -= chunk;
+    }
+    return count;
+}
+
+// interpolates at most VM_BLOCK_SIZE inputs
+static void interpolate_chunk(vm_resampler* r, const short* in, short* out, int n)
+{
+    short* x = r->line + VM_RESAMPLE_TAPS_PER_PHASE;
+    int k, p, i;
+
+    memcpy(x, in, n * sizeof(short));
+
+    for (k = 0; k < n; k++)
+    {
+        for (p = 0; p < r->factor; p++)
+        {
+            const short* h = r->phase_coefs + p * VM_RESAMPLE_TAPS_PER_PHASE;
+            int acc = 0;
+            for (i = 0; i < VM_RESAMPLE_TAPS_PER_PHASE; i++)
+            {
+                acc += h[i] * x[k - i];
+            }
+            //scaling acc itself by the factor could overflow on a full-scale input
+            out[k * r->factor + p] = vm_sat16(((acc >> 8) * r->factor) >> 7);
+        }
+    }
+
+    memmove(r->line, r->line + n, VM_RESAMPLE_TAPS_PER_PHASE * sizeof(short));
+}
+
+void vm_interpolate(vm_resampler* r, const short* in, short* out, int n)
+{
+    while (n > 0)
+    {
+        int chunk = (n > VM_BLOCK_SIZE) ? VM_BLOCK_SIZE : n;
+        interpolate_chunk(r, in, out, chunk);
+        in += chunk;
+        out += chunk * r->factor;
+        n -= chunk;
+    }
+}
@@ -0,0 +1,47 @@
+/*************************************************************************
+* Description:                                                           *
+* Polyphase resampling by an integer factor, for moving audio between    *
+* the 32kHz codec and the 8kHz Bluetooth PCM link (factor 4), 48kHz and  *
+* 8kHz (factor 6), 48kHz and 16kHz wideband (factor 3) or 16kHz and 8kHz *
+* (factor 2).  The decimator only evaluates the filter at the samples it *
+* keeps, and the interpolator only multiplies the taps that meet a real  *
+* input sample, so both cost 1/factor of filtering at the high rate.     *
+* The lowpass taps come from vm_tables.c.                                *
+**************************************************************************/
+
+#ifndef VM_RESAMPLE_H_
+#define VM_RESAMPLE_H_
+
+#include "vm_engine.h"
+
+/* Largest factor with generated taps; 2, 3, 4 and 6 are available */
+#define     VM_RESAMPLE_MAX_FACTOR      6
+#define     VM_RESAMPLE_MAX_LENGTH      (VM_RESAMPLE_MAX_FACTOR * VM_RESAMPLE_TAPS_PER_PHASE)
+
+
+// state of one resampling direction; a resampler either decimates or
+// interpolates, never both
+typedef struct
+{
+    int factor;
+    int length;                 // factor * VM_RESAMPLE_TAPS_PER_PHASE
+    const short* coefs;         // symmetric lowpass, unity gain at DC
+    short phase_coefs[VM_RESAMPLE_MAX_LENGTH];  // interpolator taps, branch-major
+    int skip;                   // decimator: inputs to drop before the next kept one
+    // last length inputs followed by the current chunk
+    short line[VM_RESAMPLE_MAX_LENGTH + VM_BLOCK_SIZE];
+} vm_resampler;
+
+
+// clears the history; returns 0 on success, -1 if there are no taps for factor
+int vm_resampler_init(vm_resampler* r, int factor);
+
+// filters and keeps every factor-th sample of n inputs; returns the number of
+// outputs written, which is n / factor when n is a multiple of factor
+int vm_decimate(vm_resampler* r, const short* in, short* out, int n);
+
+// writes n * factor outputs for n inputs
+void vm_interpolate(vm_resampler* r, const short* in, short* out, int n);
+
+
+#endif /*VM_RESAMPLE_H_*/
@@ -0,0 +1,39 @@
+/*************************************************************************
+* Description:                                                           *
+* Block forms of the saturating operations in vm_sat.h.  SSE2 and NEON   *
+* have a saturating 16-bit add, so those targets add eight samples per   *
+* instruction; everything else, the Nios included, runs the scalar loop, *
+* which also finishes whatever does not fill a whole vector.             *
+**************************************************************************/
+
+#include "vm_sat.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+void vm_sat_add_block(const short* a, const short* b, short* out, int n)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+        _mm_storeu_si128((__m128i*) (out + i), _mm_adds_epi16(x, y));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+    {
+        vst1q_s16(out + i, vqaddq_s16(vld1q_s16(a + i), vld1q_s16(b + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        out[i] = vm_sat_add16(a[i], b[i]);
+    }
+}
@@ -0,0 +1,51 @@
+/*************************************************************************
+* Description:                                                           *
+* Saturating arithmetic shared by every stage of the chain.  Results     *
+* that do not fit in 16 bits stick at full scale instead of wrapping to  *
+* the opposite sign.  The scalar forms clamp with conditional moves      *
+* rather than branches, and vm_sat_add_block uses the saturating vector  *
+* adds where the target has them.                                        *
+*                                                                        *
+* Headroom is accounted for at build time: a filter whose taps' Q15      *
+* magnitudes sum to l1 cannot overflow a 32-bit sum of products with     *
+* inputs of input_bits bits when VM_SUM_FITS(l1, input_bits) holds.      *
+* The L1 sums of the generated filters are in vm_tables.h, so a filter   *
+* that needs more headroom than its kernel provides fails to compile.    *
+**************************************************************************/
+
+#ifndef VM_SAT_H_
+#define VM_SAT_H_
+
+/* usable in #if, whose arithmetic is at least 64 bits wide */
+#define     VM_SUM_FITS(l1, input_bits)     ((l1) * (1LL << ((input_bits) - 1)) <= 2147483647LL)
+
+
+static inline short vm_sat16(int value)
+{
+    value = (value > 32767) ? 32767 : value;
+    value = (value < -32768) ? -32768 : value;
+    return (short) value;
+}
+
+static inline short vm_sat_add16(short a, short b)
+{
+    return vm_sat16(a + b);
+}
+
+// Q15 product; only -1 * -1 needs the clamp
+static inline short vm_sat_mul_q15(short a, short b)
+{
+    return vm_sat16((a * b) >> 15);
+}
+
+// floor((a + b) / 2) without forming a + b, which may not fit in 32 bits
+static inline int vm_half_sum(int a, int b)
+{
+    return (a >> 1) + (b >> 1) + (a & b & 1);
+}
+
+
+// out = sat(a + b); out may be either input
+void vm_sat_add_block(const short* a, const short* b, short* out, int n);
+
+#endif /*VM_SAT_H_*/
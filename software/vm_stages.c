@@ -0,0 +1,168 @@
+/*************************************************************************
+* Description:                                                           *
+* Instantiates vm_stages_template.h for each representation.  The Q15    *
+* and Q31 accumulators are wide enough for every filter here, the q15    *
+* ones for half the Hilbert taps, which are combined as hilbert_scalar   *
+* does.                                                                  *
+**************************************************************************/
+
+#include "vm_stages.h"
+#include "vm_sat.h"
+
+/* Rounding policies: drop the bits shifted out, or round to nearest */
+#define     ROUND_TRUNCATE(x, bits)     ((x) >> (bits))
+#define     ROUND_NEAREST(x, bits)      (((x) + (1LL << ((bits) - 1))) >> (bits))
+
+
+// saturation policies for the wider sample types; 16 bits uses vm_sat16
+static int saturate32(long long value)
+{
+    return (int) ((value > 2147483647LL) ? 2147483647LL : (value < -2147483648LL) ? -2147483648LL : value);
+}
+
+static float saturate_float(float value)
+{
+    return (value > 1.0f) ? 1.0f : (value < -1.0f) ? -1.0f : value;
+}
+
+static double saturate_double(double value)
+{
+    return (value > 1.0) ? 1.0 : (value < -1.0) ? -1.0 : value;
+}
+
+
+/* q15: the arithmetic of vm_engine */
+#define     STAGE_NAME                  q15
+#define     STAGE_SAMPLE                short
+#define     STAGE_COEF                  short
+#define     STAGE_GAIN                  int
+#define     STAGE_ACC                   int
+#define     STAGE_WIDE                  int
+#define     STAGE_COEF_FROM_Q15(c)      (c)
+#define     STAGE_GAIN_FROM_Q15(g)      (g)
+#define     STAGE_FROM_Q15(s)           (s)
+#define     STAGE_TO_DOUBLE(x)          ((x) / 32768.0)
+#define     STAGE_MAC(acc, c, x)        ((acc) += (c) * (x))
+#define     STAGE_ACC_OUT(acc)          STAGE_ROUND(acc, 15)
+#define     STAGE_ACC_OUT2(a, b)        STAGE_ROUND(vm_half_sum(a, b), 14)
+#define     STAGE_ACC_SCALE(acc, f)     STAGE_ROUND(((acc) >> 8) * (f), 7)
+#define     STAGE_MUL(c, x)             STAGE_ROUND((c) * (x), 15)
+#define     STAGE_GAIN_MUL(g, x)        STAGE_ROUND((long long) (g) * (x), 15)
+#define     STAGE_DOT2(a, b, c, d)      STAGE_ROUND((a) * (b) + (c) * (d), 15)
+#define     STAGE_SATURATE(w)           vm_sat16(w)
+#define     STAGE_ROUND(x, bits)        ROUND_TRUNCATE(x, bits)
+#define     STAGE_LANES                 1
+#include "vm_stages_template.h"
+#undef      STAGE_NAME
+#undef      STAGE_ROUND
+
+/* q15r: the same with products rounded to nearest */
+#define     STAGE_NAME                  q15r
+#define     STAGE_ROUND(x, bits)        ((int) ROUND_NEAREST(x, bits))
+#include "vm_stages_template.h"
+#undef      STAGE_NAME
+#undef      STAGE_SAMPLE
+#undef      STAGE_COEF
+#undef      STAGE_GAIN
+#undef      STAGE_ACC
+#undef      STAGE_WIDE
+#undef      STAGE_COEF_FROM_Q15
+#undef      STAGE_GAIN_FROM_Q15
+#undef      STAGE_FROM_Q15
+#undef      STAGE_TO_DOUBLE
+#undef      STAGE_MAC
+#undef      STAGE_ACC_OUT
+#undef      STAGE_ACC_OUT2
+#undef      STAGE_ACC_SCALE
+#undef      STAGE_MUL
+#undef      STAGE_GAIN_MUL
+#undef      STAGE_DOT2
+#undef      STAGE_SATURATE
+#undef      STAGE_ROUND
+#undef      STAGE_LANES
+
+/* q31: Q15 coefficients against Q31 samples; two signal products are halved
+   before they are added so that full scale cannot overflow */
+#define     STAGE_NAME                  q31
+#define     STAGE_SAMPLE                int
+#define     STAGE_COEF                  short
+#define     STAGE_GAIN                  int
+#define     STAGE_ACC                   long long
+#define     STAGE_WIDE                  long long
+#define     STAGE_COEF_FROM_Q15(c)      (c)
+#define     STAGE_GAIN_FROM_Q15(g)      (g)
+#define     STAGE_FROM_Q15(s)           ((int) (s) * 65536)
+#define     STAGE_TO_DOUBLE(x)          ((x) / 2147483648.0)
+#define     STAGE_MAC(acc, c, x)        ((acc) += (c) * (x))
+#define     STAGE_ACC_OUT(acc)          ROUND_NEAREST(acc, 15)
+#define     STAGE_ACC_OUT2(a, b)        ROUND_NEAREST((a) + (b), 15)
+#define     STAGE_ACC_SCALE(acc, f)     ROUND_NEAREST((acc) * (f), 15)
+#define     STAGE_MUL(c, x)             ROUND_NEAREST((long long) (c) * (x), 15)
+#define     STAGE_GAIN_MUL(g, x)        STAGE_MUL(g, x)
+#define     STAGE_DOT2(a, b, c, d)      ROUND_NEAREST(((long long) (a) * (b) >> 1) + ((long long) (c) * (d) >> 1), 30)
+#define     STAGE_SATURATE(w)           saturate32(w)
+#define     STAGE_LANES                 4
+#include "vm_stages_template.h"
+#undef      STAGE_NAME
+#undef      STAGE_SAMPLE
+#undef      STAGE_COEF
+#undef      STAGE_GAIN
+#undef      STAGE_ACC
+#undef      STAGE_WIDE
+#undef      STAGE_COEF_FROM_Q15
+#undef      STAGE_GAIN_FROM_Q15
+#undef      STAGE_FROM_Q15
+#undef      STAGE_TO_DOUBLE
+#undef      STAGE_MAC
+#undef      STAGE_ACC_OUT
+#undef      STAGE_ACC_OUT2
+#undef      STAGE_ACC_SCALE
+#undef      STAGE_MUL
+#undef      STAGE_GAIN_MUL
+#undef      STAGE_DOT2
+#undef      STAGE_SATURATE
+#undef      STAGE_LANES
+
+/* f32 and f64: full scale is +-1.0 and nothing is rounded but the format itself */
+#define     STAGE_NAME                  f32
+#define     STAGE_SAMPLE                float
+#define     STAGE_COEF                  float
+#define     STAGE_GAIN                  float
+#define     STAGE_ACC                   float
+#define     STAGE_WIDE                  float
+#define     STAGE_COEF_FROM_Q15(c)      ((c) / 32768.0f)
+#define     STAGE_GAIN_FROM_Q15(g)      ((g) / 32768.0f)
+#define     STAGE_FROM_Q15(s)           ((s) / 32768.0f)
+#define     STAGE_TO_DOUBLE(x)          ((double) (x))
+#define     STAGE_MAC(acc, c, x)        ((acc) += (c) * (x))
+#define     STAGE_ACC_OUT(acc)          (acc)
+#define     STAGE_ACC_OUT2(a, b)        ((a) + (b))
+#define     STAGE_ACC_SCALE(acc, f)     ((acc) * (f))
+#define     STAGE_MUL(c, x)             ((c) * (x))
+#define     STAGE_GAIN_MUL(g, x)        ((g) * (x))
+#define     STAGE_DOT2(a, b, c, d)      ((a) * (b) + (c) * (d))
+#define     STAGE_SATURATE(w)           saturate_float(w)
+#define     STAGE_LANES                 8
+#include "vm_stages_template.h"
+#undef      STAGE_NAME
+#undef      STAGE_SAMPLE
+#undef      STAGE_COEF
+#undef      STAGE_GAIN
+#undef      STAGE_ACC
+#undef      STAGE_WIDE
+#undef      STAGE_COEF_FROM_Q15
+#undef      STAGE_GAIN_FROM_Q15
+#undef      STAGE_FROM_Q15
+#undef      STAGE_SATURATE
+
+#define     STAGE_NAME                  f64
+#define     STAGE_SAMPLE                double
+#define     STAGE_COEF                  double
+#define     STAGE_GAIN                  double
+#define     STAGE_ACC                   double
+#define     STAGE_WIDE                  double
+#define     STAGE_COEF_FROM_Q15(c)      ((c) / 32768.0)
+#define     STAGE_GAIN_FROM_Q15(g)      ((g) / 32768.0)
+#define     STAGE_FROM_Q15(s)           ((s) / 32768.0)
+#define     STAGE_SATURATE(w)           saturate_double(w)
+#include "vm_stages_template.h"
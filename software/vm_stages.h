@@ -0,0 +1,78 @@
+/*************************************************************************
+* Description:                                                           *
+* The DSP stages - Hilbert filter, oscillator, mixer, echo, gain,        *
+* decimator and interpolator - written once in vm_stages_template.h and  *
+* compiled for several sample representations, so each target can use    *
+* the fastest one and the accuracy it costs can be measured              *
+* (host/typebench.c):                                                    *
+*     q15   16-bit, truncating products, saturating; the engine's and    *
+*           freq_shifter.vhd's arithmetic, bit-exact with vm_engine      *
+*     q15r  16-bit, products rounded to nearest, saturating              *
+*     q31   32-bit, rounded, saturating; Q15 coefficients                *
+*     f32   float, full scale is +-1.0, saturating at full scale         *
+*     f64   double, the same as f32; the reference for the others        *
+* Coefficients and gains are given as Q15 and converted once with        *
+* vm_stage_coefs_<name> and vm_stage_gain_from_q15_<name>, and the       *
+* oscillator is the same quarter-wave table for every representation,    *
+* so only the datapath differs.  Fixed-point gains are int rather than   *
+* short, so that they reach unity and boosts up to VM_LIMITER_MAX_GAIN.  *
+*                                                                        *
+* The stages keep no state of their own: filters read the history in     *
+* front of x, and the echo ring and oscillator phase are passed in.      *
+* The board keeps running vm_engine, whose hand-vectorized Q15 kernels   *
+* are faster than the generic q15 stages.                                *
+**************************************************************************/
+
+#ifndef VM_STAGES_H_
+#define VM_STAGES_H_
+
+#include "vm_engine.h"
+
+
+// prototypes for one representation, sample being its sample type, coef its
+// coefficient type and gain its gain type. For each name:
+//   vm_stage_coefs_name      converts n Q15 coefficients
+//   vm_stage_gain_from_q15_name converts a Q15 gain, unity being 32768, held
+//                            within +-VM_LIMITER_MAX_GAIN
+//   vm_stage_from_q15_name   converts n Q15 samples in
+//   vm_stage_to_double_name  converts n samples out, full scale being +-1.0
+//   vm_stage_hilbert_name    the VM_HILBERT_ORDER filter from its even taps; x is
+//                            preceded by VM_HILBERT_ORDER samples of history
+//   vm_stage_osc_name        n sines and cosines from *phase, advancing it by
+//                            increment per sample as vm_nco does
+//   vm_stage_mix_name        out = hilbert * sin + delayed * cos
+//   vm_stage_echo_name       vm_engine's echo, out = in + w[t - delay] with
+//                            w[t] = in + feedback * w[t - delay], on a ring of size
+//                            samples (a power of two); delay must be at least 1
+//   vm_stage_gain_name       out = gain * in
+//   vm_stage_decimate_name   keeps every factor-th of n inputs, filtered by taps; x is
+//                            preceded by length - 1 samples. Returns n / factor
+//   vm_stage_interpolate_name writes factor outputs per input, filtered by taps,
+//                            length being a multiple of factor; x is preceded by
+//                            length / factor - 1 samples
+#define VM_STAGES_DECLARE(name, sample, coef, gain)                                             \
+    void vm_stage_coefs_##name(const short* q15, coef* out, int n);                            \
+    gain vm_stage_gain_from_q15_##name(int q15);                                               \
+    void vm_stage_from_q15_##name(const short* in, sample* out, int n);                        \
+    void vm_stage_to_double_##name(const sample* in, double* out, int n);                      \
+    void vm_stage_hilbert_##name(const sample* x, sample* out, int n, const coef* taps);       \
+    void vm_stage_osc_##name(unsigned int* phase, int increment, sample* sin_out,              \
+                             sample* cos_out, int n);                                          \
+    void vm_stage_mix_##name(const sample* hilbert, const sample* delayed, const sample* sin_in, \
+                             const sample* cos_in, sample* out, int n);                        \
+    void vm_stage_echo_##name(sample* ring, unsigned int size, unsigned int* write_index,      \
+                              int delay, coef feedback, const sample* in, sample* out, int n); \
+    void vm_stage_gain_##name(const sample* in, sample* out, int n, gain g);                   \
+    int vm_stage_decimate_##name(const sample* x, sample* out, int n, const coef* taps,        \
+                                 int length, int factor);                                      \
+    void vm_stage_interpolate_##name(const sample* x, sample* out, int n, const coef* taps,    \
+                                     int length, int factor);
+
+VM_STAGES_DECLARE(q15, short, short, int)
+VM_STAGES_DECLARE(q15r, short, short, int)
+VM_STAGES_DECLARE(q31, int, short, int)
+VM_STAGES_DECLARE(f32, float, float, float)
+VM_STAGES_DECLARE(f64, double, double, double)
+
+
+#endif /*VM_STAGES_H_*/
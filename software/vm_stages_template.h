@@ -0,0 +1,243 @@
+/*************************************************************************
+* Description:                                                           *
+* Body of the stages in vm_stages.h for one sample representation.       *
+* Not a normal header: vm_stages.c includes it once per representation,  *
+* after defining                                                         *
+*     STAGE_NAME             suffix of the function names, e.g. q15      *
+*     STAGE_SAMPLE           sample type                                 *
+*     STAGE_COEF             coefficient type                            *
+*     STAGE_GAIN             gain type, able to hold unity and boosts    *
+*     STAGE_ACC              filter accumulator type                     *
+*     STAGE_WIDE             type holding a sum of samples or a product  *
+*                            scaled back to sample scale, unsaturated    *
+*     STAGE_COEF_FROM_Q15(c), STAGE_GAIN_FROM_Q15(g), STAGE_FROM_Q15(s), *
+*     STAGE_TO_DOUBLE(x)                                                 *
+*     STAGE_MAC(acc, c, x)   acc += c * x, x being a STAGE_WIDE          *
+*     STAGE_ACC_OUT(acc)     the accumulator at sample scale, rounded    *
+*     STAGE_ACC_OUT2(a, b)   the same for the sum of two accumulators,   *
+*                            which need not fit in one                   *
+*     STAGE_ACC_SCALE(acc, f) the accumulator at sample scale times the  *
+*                            integer f, rounded                          *
+*     STAGE_MUL(c, x)        coefficient times sample, rounded           *
+*     STAGE_GAIN_MUL(g, x)   gain times sample, rounded                  *
+*     STAGE_DOT2(a, b, c, d) a * b + c * d of four samples, rounded      *
+*     STAGE_SATURATE(w)      a STAGE_WIDE as a sample                    *
+*     STAGE_LANES            partial sums per decimator output; 32-bit   *
+*                            integer sums vectorize with 1, wider and    *
+*                            floating point ones need several            *
+* The rounding and saturation policies are chosen in those macros.       *
+**************************************************************************/
+
+#define     STAGE(stage)                STAGE_PASTE(stage, STAGE_NAME)
+#define     STAGE_PASTE(stage, name)    STAGE_PASTE2(stage, name)
+#define     STAGE_PASTE2(stage, name)   vm_stage_##stage##_##name
+
+
+void STAGE(coefs)(const short* q15, STAGE_COEF* out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = STAGE_COEF_FROM_Q15(q15[i]);
+    }
+}
+
+STAGE_GAIN STAGE(gain_from_q15)(int q15)
+{
+    if (q15 > VM_LIMITER_MAX_GAIN)
+    {
+        q15 = VM_LIMITER_MAX_GAIN;
+    }
+    else if (q15 < -VM_LIMITER_MAX_GAIN)
+    {
+        q15 = -VM_LIMITER_MAX_GAIN;
+    }
+    return STAGE_GAIN_FROM_Q15(q15);
+}
+
+void STAGE(from_q15)(const short* in, STAGE_SAMPLE* out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = STAGE_FROM_Q15(in[i]);
+    }
+}
+
+void STAGE(to_double)(const STAGE_SAMPLE* in, double* out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = STAGE_TO_DOUBLE(in[i]);
+    }
+}
+
+// folded like hilbert_scalar: each even tap multiplies x[i - k] - x[i - order + k],
+// and alternate taps are summed apart, as there, to keep integer sums in range.
+// Taps are applied one at a time over a chunk, so the inner loop is unit-stride and
+// vectorizes for every representation without reordering any output's sum
+void STAGE(hilbert)(const STAGE_SAMPLE* x, STAGE_SAMPLE* out, int n, const STAGE_COEF* taps)
+{
+    STAGE_ACC even[VM_BLOCK_SIZE];
+    STAGE_ACC odd[VM_BLOCK_SIZE];
+    int start, i, k;
+
+    for (start = 0; start < n; start += VM_BLOCK_SIZE)
+    {
+        int count = (n - start < VM_BLOCK_SIZE) ? n - start : VM_BLOCK_SIZE;
+
+        for (i = 0; i < count; i++)
+        {
+            even[i] = 0;
+            odd[i] = 0;
+        }
+        for (k = 0; k < VM_HILBERT_TAPS; k++)
+        {
+            const STAGE_SAMPLE* near = x + start - 2*k;
+            const STAGE_SAMPLE* far = x + start - VM_HILBERT_ORDER + 2*k;
+            STAGE_ACC* acc = (k & 1) ? odd : even;
+            STAGE_COEF h = taps[k];
+            for (i = 0; i < count; i++)
+            {
+                STAGE_MAC(acc[i], h, (STAGE_WIDE) near[i] - far[i]);
+            }
+        }
+        for (i = 0; i < count; i++)
+        {
+            out[start + i] = STAGE_SATURATE(STAGE_ACC_OUT2(even[i], odd[i]));
+        }
+    }
+}
+
+void STAGE(osc)(unsigned int* phase, int increment, STAGE_SAMPLE* sin_out, STAGE_SAMPLE* cos_out, int n)
+{
+    unsigned int p = *phase;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        short sin_value, cos_value;
+        vm_nco_lookup(p, &sin_value, &cos_value);
+        sin_out[i] = STAGE_FROM_Q15(sin_value);
+        cos_out[i] = STAGE_FROM_Q15(cos_value);
+        p += (unsigned int) increment;
+    }
+    *phase = p;
+}
+
+void STAGE(mix)(const STAGE_SAMPLE* hilbert, const STAGE_SAMPLE* delayed, const STAGE_SAMPLE* sin_in,
+                const STAGE_SAMPLE* cos_in, STAGE_SAMPLE* out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = STAGE_SATURATE(STAGE_DOT2(hilbert[i], sin_in[i], delayed[i], cos_in[i]));
+    }
+}
+
+void STAGE(echo)(STAGE_SAMPLE* ring, unsigned int size, unsigned int* write_index, int delay,
+                 STAGE_COEF feedback, const STAGE_SAMPLE* in, STAGE_SAMPLE* out, int n)
+{
+    unsigned int mask = size - 1;
+    unsigned int w = *write_index;
+    int i;
+
+    for (i = 0; i < n; i++, w++)
+    {
+        STAGE_SAMPLE echoed = ring[(w - delay) & mask];
+        ring[w & mask] = STAGE_SATURATE((STAGE_WIDE) in[i] + STAGE_MUL(feedback, echoed));
+        out[i] = STAGE_SATURATE((STAGE_WIDE) in[i] + echoed);
+    }
+    *write_index = w;
+}
+
+void STAGE(gain)(const STAGE_SAMPLE* in, STAGE_SAMPLE* out, int n, STAGE_GAIN gain)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = STAGE_SATURATE(STAGE_GAIN_MUL(gain, in[i]));
+    }
+}
+
+// only the kept outputs are computed. Each one's sum is split over STAGE_LANES
+// partial sums, which lets floating point vectorize without reassociating
+int STAGE(decimate)(const STAGE_SAMPLE* x, STAGE_SAMPLE* out, int n, const STAGE_COEF* taps,
+                    int length, int factor)
+{
+    int count = 0;
+    int i, j, k;
+
+    for (i = factor - 1; i < n; i += factor)
+    {
+        STAGE_ACC partial[STAGE_LANES] = {0};
+        STAGE_ACC acc = 0;
+
+        for (k = 0; k + STAGE_LANES <= length; k += STAGE_LANES)
+        {
+            for (j = 0; j < STAGE_LANES; j++)
+            {
+                STAGE_MAC(partial[j], taps[k + j], (STAGE_WIDE) x[i - k - j]);
+            }
+        }
+        for (; k < length; k++)
+        {
+            STAGE_MAC(acc, taps[k], (STAGE_WIDE) x[i - k]);
+        }
+        for (j = 0; j < STAGE_LANES; j++)
+        {
+            acc += partial[j];
+        }
+        out[count++] = STAGE_SATURATE(STAGE_ACC_OUT(acc));
+    }
+    return count;
+}
+
+
+// vm_resample's interpolator: output phase p of each input is branch p of the lowpass,
+// taps p, p + factor, ..., scaled by the factor. Like the Hilbert filter, taps are
+// applied one at a time over a chunk so that the inner loop is unit-stride
+void STAGE(interpolate)(const STAGE_SAMPLE* x, STAGE_SAMPLE* out, int n, const STAGE_COEF* taps,
+                        int length, int factor)
+{
+    STAGE_ACC acc[VM_BLOCK_SIZE];
+    int per_phase = length / factor;
+    int start, p, i, k;
+
+    for (start = 0; start < n; start += VM_BLOCK_SIZE)
+    {
+        int count = (n - start < VM_BLOCK_SIZE) ? n - start : VM_BLOCK_SIZE;
+
+        for (p = 0; p < factor; p++)
+        {
+            for (k = 0; k < count; k++)
+            {
+                acc[k] = 0;
+            }
+            for (i = 0; i < per_phase; i++)
+            {
+                const STAGE_SAMPLE* src = x + start - i;
+                STAGE_COEF h = taps[p + i * factor];
+                for (k = 0; k < count; k++)
+                {
+                    STAGE_MAC(acc[k], h, (STAGE_WIDE) src[k]);
+                }
+            }
+            for (k = 0; k < count; k++)
+            {
+                out[(start + k) * factor + p] = STAGE_SATURATE(STAGE_ACC_SCALE(acc[k], factor));
+            }
+        }
+    }
+}
+
+
+#undef      STAGE
+#undef      STAGE_PASTE
+#undef      STAGE_PASTE2
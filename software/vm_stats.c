@@ -0,0 +1,134 @@
+/*************************************************************************
+* Description:                                                           *
+* Audio path statistics with a sequence-count snapshot.                  *
+**************************************************************************/
+
+#include <string.h>
+#include "vm_stats.h"
+
+// orders the sequence count against the counters on both sides
+#define     VM_STATS_BARRIER()      __sync_synchronize()
+
+
+void vm_stats_init(vm_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->counters.min_latency = 0xffffffffu;
+}
+
+void vm_stats_write_begin(vm_stats* stats)
+{
+    stats->sequence++;
+    VM_STATS_BARRIER();
+}
+
+void vm_stats_write_end(vm_stats* stats)
+{
+    VM_STATS_BARRIER();
+    stats->sequence++;
+}
+
+void vm_stats_stage(vm_stats* stats, int stage, unsigned int ticks)
+{
+    vm_stage_stats* s = &stats->counters.stages[stage];
+
+    s->runs++;
+    s->total_ticks += ticks;
+    if (ticks > s->max_ticks)
+    {
+        s->max_ticks = ticks;
+    }
+}
+
+void vm_stats_latency(vm_stats* stats, unsigned int ticks)
+{
+    vm_stats_counters* c = &stats->counters;
+    int bin = 0;
+
+    while (bin < VM_STATS_HIST_BINS - 1 && (ticks >> bin) != 0)
+    {
+        bin++;
+    }
+    c->latency_hist[bin]++;
+    c->blocks++;
+    c->total_latency += ticks;
+    if (ticks < c->min_latency)
+    {
+        c->min_latency = ticks;
+    }
+    if (ticks > c->max_latency)
+    {
+        c->max_latency = ticks;
+    }
+}
+
+int vm_stats_snapshot(const vm_stats* stats, vm_stats_counters* out)
+{
+    unsigned int before, after;
+    int tries;
+
+    for (tries = 0; tries < VM_STATS_SNAPSHOT_TRIES; tries++)
+    {
+        before = stats->sequence;
+        VM_STATS_BARRIER();
+        memcpy(out, (const void*) &stats->counters, sizeof(*out));
+        VM_STATS_BARRIER();
+        after = stats->sequence;
+        if ((before & 1) == 0 && before == after)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void vm_stats_merge(vm_stats_counters* dst, const vm_stats_counters* src)
+{
+    int i;
+
+    for (i = 0; i < VM_STATS_MAX_STAGES; i++)
+    {
+        dst->stages[i].runs += src->stages[i].runs;
+        dst->stages[i].total_ticks += src->stages[i].total_ticks;
+        if (src->stages[i].max_ticks > dst->stages[i].max_ticks)
+        {
+            dst->stages[i].max_ticks = src->stages[i].max_ticks;
+        }
+    }
+    for (i = 0; i < VM_STATS_HIST_BINS; i++)
+    {
+        dst->latency_hist[i] += src->latency_hist[i];
+    }
+    dst->blocks += src->blocks;
+    dst->total_latency += src->total_latency;
+    if (src->min_latency < dst->min_latency)
+    {
+        dst->min_latency = src->min_latency;
+    }
+    if (src->max_latency > dst->max_latency)
+    {
+        dst->max_latency = src->max_latency;
+    }
+    dst->overruns += src->overruns;
+    dst->underruns += src->underruns;
+    dst->stale_samples += src->stale_samples;
+}
+
+unsigned int vm_stats_percentile(const vm_stats_counters* counters, double fraction)
+{
+    unsigned long target = (unsigned long) (fraction * counters->blocks);
+    unsigned long seen = 0;
+    int bin;
+
+    for (bin = 0; bin < VM_STATS_HIST_BINS; bin++)
+    {
+        seen += counters->latency_hist[bin];
+        if (seen >= target && seen > 0)
+        {
+            //the bin's upper edge, but never beyond the worst block seen
+            unsigned int bound = (bin == 0) ? 0 : (1u << bin) - 1;
+            return (bound < counters->max_latency) ? bound : counters->max_latency;
+        }
+    }
+    return counters->max_latency;
+}
@@ -0,0 +1,80 @@
+/*************************************************************************
+* Description:                                                           *
+* Low-overhead audio path statistics: time spent per stage, a histogram  *
+* of per-block latency, and counters for overruns, underruns and stale   *
+* samples.  Times are in ticks of whatever counter the caller reads      *
+* (alt_timestamp on the board, nanoseconds on the host); only            *
+* differences are used, so a wrapping 32-bit counter is fine.            *
+*                                                                        *
+* Each vm_stats has a single writer.  Updates are bracketed by           *
+* vm_stats_write_begin/end, which bump a sequence count, and             *
+* vm_stats_snapshot retries its copy until it saw no update in           *
+* progress, so readers never block the audio path and never take a       *
+* lock.  The retries are bounded: a reader that preempts the writer      *
+* mid-update cannot wait for it to finish, so it gets a busy result      *
+* and tries again later.  Threads that each own a vm_stats combine them  *
+* with vm_stats_merge.                                                   *
+**************************************************************************/
+
+#ifndef VM_STATS_H_
+#define VM_STATS_H_
+
+#define     VM_STATS_MAX_STAGES     4
+#define     VM_STATS_HIST_BINS      32      // bin b counts latencies in [2^(b-1), 2^b) ticks
+#define     VM_STATS_SNAPSHOT_TRIES 4
+
+
+typedef struct
+{
+    unsigned long runs;
+    unsigned long long total_ticks;
+    unsigned int max_ticks;
+} vm_stage_stats;
+
+typedef struct
+{
+    vm_stage_stats stages[VM_STATS_MAX_STAGES];
+
+    unsigned long blocks;                   // blocks with a recorded latency
+    unsigned long long total_latency;
+    unsigned int min_latency;
+    unsigned int max_latency;
+    unsigned long latency_hist[VM_STATS_HIST_BINS];
+
+    unsigned long overruns;                 // input found full, samples probably lost
+    unsigned long underruns;                // output found empty, a gap was heard
+    unsigned long stale_samples;            // samples repeated because none had arrived
+} vm_stats_counters;
+
+typedef struct
+{
+    volatile unsigned int sequence;         // odd while an update is in progress
+    vm_stats_counters counters;
+} vm_stats;
+
+
+void vm_stats_init(vm_stats* stats);
+
+// brackets a group of updates from the owning thread
+void vm_stats_write_begin(vm_stats* stats);
+void vm_stats_write_end(vm_stats* stats);
+
+// records one run of stage taking ticks; call between write_begin and write_end
+void vm_stats_stage(vm_stats* stats, int stage, unsigned int ticks);
+
+// records the latency of one block; call between write_begin and write_end
+void vm_stats_latency(vm_stats* stats, unsigned int ticks);
+
+// copies a consistent view of the counters; safe from any thread. Returns 0, or -1
+// if an update was in progress for VM_STATS_SNAPSHOT_TRIES tries, leaving out undefined
+int vm_stats_snapshot(const vm_stats* stats, vm_stats_counters* out);
+
+// adds the counters of src into dst
+void vm_stats_merge(vm_stats_counters* dst, const vm_stats_counters* src);
+
+// smallest latency that at least fraction of the blocks stayed under, to the
+// resolution of the histogram
+unsigned int vm_stats_percentile(const vm_stats_counters* counters, double fraction);
+
+
+#endif /*VM_STATS_H_*/
@@ -0,0 +1,643 @@
+// generated by host/gentables.c -n 320 -a 32768 -q 8 -b 0.05 -o 30 -o 62 -o 102 -p 24 -r 2 -r 3 -r 4 -r 6
+// do not edit; rerun the generator instead
+
+#include "vm_tables.h"
+
+const int sine_samples[VM_NUM_SINE_SAMPLES] = {
+    0,
+    643,
+    1286,
+    1929,
+    2571,
+    3212,
+    3851,
+    4490,
+    5126,
+    5760,
+    6393,
+    7022,
+    7650,
+    8274,
+    8895,
+    9512,
+    10126,
+    10736,
+    11342,
+    11943,
+    12540,
+    13132,
+    13719,
+    14300,
+    14876,
+    15447,
+    16011,
+    16569,
+    17121,
+    17666,
+    18205,
+    18736,
+    19261,
+    19777,
+    20286,
+    20788,
+    21281,
+    21766,
+    22243,
+    22711,
+    23170,
+    23621,
+    24062,
+    24494,
+    24917,
+    25330,
+    25733,
+    26127,
+    26510,
+    26883,
+    27246,
+    27598,
+    27939,
+    28270,
+    28590,
+    28899,
+    29197,
+    29483,
+    29758,
+    30022,
+    30274,
+    30514,
+    30743,
+    30959,
+    31164,
+    31357,
+    31538,
+    31706,
+    31863,
+    32007,
+    32138,
+    32258,
+    32365,
+    32459,
+    32541,
+    32610,
+    32667,
+    32711,
+    32743,
+    32762,
+    32767,
+    32762,
+    32743,
+    32711,
+    32667,
+    32610,
+    32541,
+    32459,
+    32365,
+    32258,
+    32138,
+    32007,
+    31863,
+    31706,
+    31538,
+    31357,
+    31164,
+    30959,
+    30743,
+    30514,
+    30274,
+    30022,
+    29758,
+    29483,
+    29197,
+    28899,
+    28590,
+    28270,
+    27939,
+    27598,
+    27246,
+    26883,
+    26510,
+    26127,
+    25733,
+    25330,
+    24917,
+    24494,
+    24062,
+    23621,
+    23170,
+    22711,
+    22243,
+    21766,
+    21281,
+    20788,
+    20286,
+    19777,
+    19261,
+    18736,
+    18205,
+    17666,
+    17121,
+    16569,
+    16011,
+    15447,
+    14876,
+    14300,
+    13719,
+    13132,
+    12540,
+    11943,
+    11342,
+    10736,
+    10126,
+    9512,
+    8895,
+    8274,
+    7650,
+    7022,
+    6393,
+    5760,
+    5126,
+    4490,
+    3851,
+    3212,
+    2571,
+    1929,
+    1286,
+    643,
+    0,
+    -643,
+    -1286,
+    -1929,
+    -2571,
+    -3212,
+    -3851,
+    -4490,
+    -5126,
+    -5760,
+    -6393,
+    -7022,
+    -7650,
+    -8274,
+    -8895,
+    -9512,
+    -10126,
+    -10736,
+    -11342,
+    -11943,
+    -12540,
+    -13132,
+    -13719,
+    -14300,
+    -14876,
+    -15447,
+    -16011,
+    -16569,
+    -17121,
+    -17666,
+    -18205,
+    -18736,
+    -19261,
+    -19777,
+    -20286,
+    -20788,
+    -21281,
+    -21766,
+    -22243,
+    -22711,
+    -23170,
+    -23621,
+    -24062,
+    -24494,
+    -24917,
+    -25330,
+    -25733,
+    -26127,
+    -26510,
+    -26883,
+    -27246,
+    -27598,
+    -27939,
+    -28270,
+    -28590,
+    -28899,
+    -29197,
+    -29483,
+    -29758,
+    -30022,
+    -30274,
+    -30514,
+    -30743,
+    -30959,
+    -31164,
+    -31357,
+    -31538,
+    -31706,
+    -31863,
+    -32007,
+    -32138,
+    -32258,
+    -32365,
+    -32459,
+    -32541,
+    -32610,
+    -32667,
+    -32711,
+    -32743,
+    -32762,
+    -32768,
+    -32762,
+    -32743,
+    -32711,
+    -32667,
+    -32610,
+    -32541,
+    -32459,
+    -32365,
+    -32258,
+    -32138,
+    -32007,
+    -31863,
+    -31706,
+    -31538,
+    -31357,
+    -31164,
+    -30959,
+    -30743,
+    -30514,
+    -30274,
+    -30022,
+    -29758,
+    -29483,
+    -29197,
+    -28899,
+    -28590,
+    -28270,
+    -27939,
+    -27598,
+    -27246,
+    -26883,
+    -26510,
+    -26127,
+    -25733,
+    -25330,
+    -24917,
+    -24494,
+    -24062,
+    -23621,
+    -23170,
+    -22711,
+    -22243,
+    -21766,
+    -21281,
+    -20788,
+    -20286,
+    -19777,
+    -19261,
+    -18736,
+    -18205,
+    -17666,
+    -17121,
+    -16569,
+    -16011,
+    -15447,
+    -14876,
+    -14300,
+    -13719,
+    -13132,
+    -12540,
+    -11943,
+    -11342,
+    -10736,
+    -10126,
+    -9512,
+    -8895,
+    -8274,
+    -7650,
+    -7022,
+    -6393,
+    -5760,
+    -5126,
+    -4490,
+    -3851,
+    -3212,
+    -2571,
+    -1929,
+    -1286,
+    -643
+};
+
+const short quarter_sine_samples[(1 << VM_QUARTER_SINE_BITS) + 1] = {
+    0,
+    201,
+    402,
+    603,
+    804,
+    1005,
+    1206,
+    1407,
+    1608,
+    1809,
+    2009,
+    2210,
+    2411,
+    2611,
+    2811,
+    3012,
+    3212,
+    3412,
+    3612,
+    3812,
+    4011,
+    4211,
+    4410,
+    4609,
+    4808,
+    5007,
+    5205,
+    5404,
+    5602,
+    5800,
+    5998,
+    6195,
+    6393,
+    6590,
+    6787,
+    6983,
+    7180,
+    7376,
+    7571,
+    7767,
+    7962,
+    8157,
+    8351,
+    8546,
+    8740,
+    8933,
+    9127,
+    9319,
+    9512,
+    9704,
+    9896,
+    10088,
+    10279,
+    10469,
+    10660,
+    10850,
+    11039,
+    11228,
+    11417,
+    11605,
+    11793,
+    11980,
+    12167,
+    12354,
+    12540,
+    12725,
+    12910,
+    13095,
+    13279,
+    13463,
+    13646,
+    13828,
+    14010,
+    14192,
+    14373,
+    14553,
+    14733,
+    14912,
+    15091,
+    15269,
+    15447,
+    15624,
+    15800,
+    15976,
+    16151,
+    16326,
+    16500,
+    16673,
+    16846,
+    17018,
+    17190,
+    17361,
+    17531,
+    17700,
+    17869,
+    18037,
+    18205,
+    18372,
+    18538,
+    18703,
+    18868,
+    19032,
+    19195,
+    19358,
+    19520,
+    19681,
+    19841,
+    20001,
+    20160,
+    20318,
+    20475,
+    20632,
+    20788,
+    20943,
+    21097,
+    21251,
+    21403,
+    21555,
+    21706,
+    21856,
+    22006,
+    22154,
+    22302,
+    22449,
+    22595,
+    22740,
+    22884,
+    23028,
+    23170,
+    23312,
+    23453,
+    23593,
+    23732,
+    23870,
+    24008,
+    24144,
+    24279,
+    24414,
+    24548,
+    24680,
+    24812,
+    24943,
+    25073,
+    25202,
+    25330,
+    25457,
+    25583,
+    25708,
+    25833,
+    25956,
+    26078,
+    26199,
+    26320,
+    26439,
+    26557,
+    26674,
+    26791,
+    26906,
+    27020,
+    27133,
+    27246,
+    27357,
+    27467,
+    27576,
+    27684,
+    27791,
+    27897,
+    28002,
+    28106,
+    28209,
+    28311,
+    28411,
+    28511,
+    28610,
+    28707,
+    28803,
+    28899,
+    28993,
+    29086,
+    29178,
+    29269,
+    29359,
+    29448,
+    29535,
+    29622,
+    29707,
+    29792,
+    29875,
+    29957,
+    30038,
+    30118,
+    30196,
+    30274,
+    30350,
+    30425,
+    30499,
+    30572,
+    30644,
+    30715,
+    30784,
+    30853,
+    30920,
+    30986,
+    31050,
+    31114,
+    31177,
+    31238,
+    31298,
+    31357,
+    31415,
+    31471,
+    31527,
+    31581,
+    31634,
+    31686,
+    31737,
+    31786,
+    31834,
+    31881,
+    31927,
+    31972,
+    32015,
+    32058,
+    32099,
+    32138,
+    32177,
+    32214,
+    32251,
+    32286,
+    32319,
+    32352,
+    32383,
+    32413,
+    32442,
+    32470,
+    32496,
+    32522,
+    32546,
+    32568,
+    32590,
+    32610,
+    32629,
+    32647,
+    32664,
+    32679,
+    32693,
+    32706,
+    32718,
+    32729,
+    32738,
+    32746,
+    32753,
+    32758,
+    32762,
+    32766,
+    32767,
+    32767
+};
+
+const short hilbert_coefs_30[8] = {
+    -418, -692, -1070, -1603, -2398, -3742, -6690, -20772
+};
+
+const short hilbert_coefs_62[16] = {
+    -28, -55, -94, -148, -221, -317, -440, -599, -804, -1069, -1423, -1916, -2658,
+    -3937, -6810, -20813
+};
+
+const short hilbert_coefs_102[26] = {
+    -1, -3, -6, -10, -17, -26, -39, -56, -78, -107, -144, -190, -247,
+    -318, -404, -509, -638, -797, -996, -1250, -1587, -2058, -2774, -4023, -6863, -20830
+};
+
+const short resample_coefs_2[48] = {
+    -12, -19, 29, 42, -57, -76, 100, 127, -160, -200, 246, 300,
+    -364, -440, 532, 642, -780, -954, 1185, 1510, -2006, -2878, 4875, 14743,
+    14743, 4875, -2878, -2006, 1510, 1185, -954, -780, 642, 532, -440, -364,
+    300, 246, -200, -160, 127, 100, -76, -57, 42, 29, -19, -12
+};
+
+const short resample_coefs_3[72] = {
+    -5, -15, -10, 14, 35, 22, -27, -65, -39, 46, 109, 64,
+    -74, -172, -99, 113, 259, 148, -168, -381, -216, 244, 554, 314,
+    -357, -814, -467, 539, 1258, 744, -899, -2237, -1459, 2064, 6929, 10431,
+    10431, 6929, 2064, -1459, -2237, -899, 744, 1258, 539, -467, -814, -357,
+    314, 554, 244, -216, -381, -168, 148, 259, 113, -99, -172, -74,
+    64, 109, 46, -39, -65, -27, 22, 35, 14, -10, -15, -5
+};
+
+const short resample_coefs_4[96] = {
+    -3, -10, -12, -6, 8, 22, 27, 13, -15, -42, -49, -23,
+    26, 72, 81, 38, -42, -114, -126, -58, 64, 172, 190, 87,
+    -95, -253, -277, -126, 138, 367, 403, 183, -202, -538, -594, -273,
+    304, 822, 927, 437, -503, -1422, -1701, -870, 1127, 3833, 6413, 7985,
+    7985, 6413, 3833, 1127, -870, -1701, -1422, -503, 437, 927, 822, 304,
+    -273, -594, -538, -202, 183, 403, 367, 138, -126, -277, -253, -95,
+    87, 190, 172, 64, -58, -126, -114, -42, 38, 81, 72, 26,
+    -23, -49, -42, -15, 13, 27, 22, 8, -6, -12, -10, -3
+};
+
+const short resample_coefs_6[144] = {
+    -1, -5, -7, -9, -7, -3, 3, 11, 16, 18, 15, 6,
+    -7, -20, -31, -34, -27, -11, 12, 35, 52, 56, 44, 17,
+    -19, -55, -81, -87, -68, -27, 29, 84, 122, 131, 102, 40,
+    -42, -123, -180, -191, -149, -58, 62, 179, 260, 277, 216, 84,
+    -90, -262, -382, -408, -320, -125, 135, 397, 585, 634, 504, 202,
+    -222, -670, -1020, -1149, -960, -408, 485, 1625, 2865, 4021, 4915, 5401,
+    5401, 4915, 4021, 2865, 1625, 485, -408, -960, -1149, -1020, -670, -222,
+    202, 504, 634, 585, 397, 135, -125, -320, -408, -382, -262, -90,
+    84, 216, 277, 260, 179, 62, -58, -149, -191, -180, -123, -42,
+    40, 102, 131, 122, 84, 29, -27, -68, -87, -81, -55, -19,
+    17, 44, 56, 52, 35, 12, -11, -27, -34, -31, -20, -7,
+    6, 15, 18, 16, 11, 3, -3, -7, -9, -7, -5, -1
+};
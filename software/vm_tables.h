@@ -0,0 +1,42 @@
+// generated by host/gentables.c -n 320 -a 32768 -q 8 -b 0.05 -o 30 -o 62 -o 102 -p 24 -r 2 -r 3 -r 4 -r 6
+// do not edit; rerun the generator instead
+
+#ifndef VM_TABLES_H_
+#define VM_TABLES_H_
+
+#define     VM_NUM_SINE_SAMPLES     320
+#define     VM_QUARTER_SINE_BITS    8
+#define     VM_RESAMPLE_TAPS_PER_PHASE  24
+
+// one period of a sine wave, peak amplitude 32768, in 320 intervals
+extern const int sine_samples[VM_NUM_SINE_SAMPLES];
+
+// first quarter period of the same sine wave in 2^VM_QUARTER_SINE_BITS intervals;
+// the last entry is the peak, kept so that interpolation never needs to wrap
+extern const short quarter_sine_samples[(1 << VM_QUARTER_SINE_BITS) + 1];
+
+// even taps h0, h2, ... of the Hilbert filter of each order, in Q15
+extern const short hilbert_coefs_30[8];
+extern const short hilbert_coefs_62[16];
+extern const short hilbert_coefs_102[26];
+
+// symmetric lowpass for resampling by each factor, in Q15, unity gain at DC
+extern const short resample_coefs_2[48];
+extern const short resample_coefs_3[72];
+extern const short resample_coefs_4[96];
+extern const short resample_coefs_6[144];
+
+// sums of the tap magnitudes, for the headroom checks of vm_sat.h: entries
+// 0, 2, ... and 1, 3, ... of each hilbert_coefs table, and each resampling lowpass
+#define     VM_HILBERT_L1_30_EVEN       10576
+#define     VM_HILBERT_L1_30_ODD        26809
+#define     VM_HILBERT_L1_62_EVEN       12478
+#define     VM_HILBERT_L1_62_ODD        28854
+#define     VM_HILBERT_L1_102_EVEN      13794
+#define     VM_HILBERT_L1_102_ODD       30177
+#define     VM_RESAMPLE_L1_2            64554
+#define     VM_RESAMPLE_L1_3            62782
+#define     VM_RESAMPLE_L1_4            62186
+#define     VM_RESAMPLE_L1_6            61796
+
+#endif /*VM_TABLES_H_*/